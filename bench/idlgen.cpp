@@ -0,0 +1,201 @@
+/*
+* Nirvana IDL to C++ compiler.
+*
+* This is a part of the Nirvana project.
+*
+* Author: Igor Popov
+*
+* Copyright (c) 2021 Igor Popov.
+*
+* This program is free software; you can redistribute it and/or modify
+* it under the terms of the GNU Lesser General Public License as published by
+* the Free Software Foundation; either version 3 of the License, or
+* (at your option) any later version.
+*
+* This program is distributed in the hope that it will be useful,
+* but WITHOUT ANY WARRANTY; without even the implied warranty of
+* MERCHANTABILITY or FITNESS FOR A PARTICULAR PURPOSE.  See the
+* GNU General Public License for more details.
+*
+* You should have received a copy of the GNU Lesser General Public
+* License along with this library.  If not, see <http://www.gnu.org/licenses/>.
+*
+* Send comments and/or bug reports to:
+*  popov.nirvana@gmail.com
+*/
+
+// Synthetic IDL corpus generator for the compiler benchmark.
+// Usage: idlgen <output directory> <files> <modules> <interfaces> <operations> <depth> <members>
+
+#include <filesystem>
+#include <fstream>
+#include <iostream>
+#include <stdexcept>
+#include <string>
+#include <stdlib.h>
+
+namespace {
+
+struct Scale
+{
+	unsigned files;
+	unsigned modules;     // Modules per file
+	unsigned interfaces;  // Independent interfaces per module
+	unsigned operations;  // Operations per interface
+	unsigned depth;       // Inheritance chain length per module
+	unsigned members;     // Struct members and union cases
+};
+
+const char* const member_types [] = {
+	"long",
+	"double",
+	"string",
+	"LongSeq",
+	"boolean",
+	"unsigned long long",
+	"octet",
+	"StringSeqSeq",
+	"Color",
+	"wstring",
+	"Fixed",
+	"Point"
+};
+
+const size_t member_type_cnt = sizeof (member_types) / sizeof (*member_types);
+
+void types (std::ostream& out, const Scale& scale)
+{
+	out << "\ttypedef sequence <long> LongSeq;\n"
+		"\ttypedef sequence <string> StringSeq;\n"
+		"\ttypedef sequence <StringSeq> StringSeqSeq;\n"
+		"\ttypedef fixed <10, 2> Fixed;\n"
+		"\tenum Color { RED, GREEN, BLUE };\n"
+		"\tstruct Point { long x; long y; double z; };\n"
+		"\ttypedef Point Matrix [16][16];\n\n";
+
+	out << "\tstruct Big {\n";
+	for (unsigned i = 0; i < scale.members; ++i) {
+		out << "\t\t" << member_types [i % member_type_cnt] << " m" << i << ";\n";
+	}
+	out << "\t\tMatrix matrix;\n"
+		"\t};\n"
+		"\ttypedef sequence <Big> BigSeq;\n\n";
+
+	out << "\tunion Variant switch (long) {\n";
+	for (unsigned i = 0; i < scale.members; ++i) {
+		out << "\t\tcase " << i << ": " << member_types [i % member_type_cnt] << " v" << i << ";\n";
+	}
+	out << "\t\tdefault: Big big;\n"
+		"\t};\n\n";
+
+	out << "\texception Error {\n"
+		"\t\tstring reason;\n"
+		"\t\tlong code;\n"
+		"\t};\n\n";
+}
+
+void operations (std::ostream& out, const std::string& prefix, unsigned cnt)
+{
+	for (unsigned i = 0; i < cnt; ++i) {
+		switch (i % 4) {
+			case 0:
+				out << "\t\tBig " << prefix << i << " (in long a, inout string b, out LongSeq c) raises (Error);\n";
+				break;
+			case 1:
+				out << "\t\tvoid " << prefix << i << " (in Variant v, out BigSeq s);\n";
+				break;
+			case 2:
+				out << "\t\tStringSeqSeq " << prefix << i << " (in Point p, inout Color c);\n";
+				break;
+			case 3:
+				out << "\t\toneway void " << prefix << i << " (in Big b);\n";
+				break;
+		}
+	}
+}
+
+void module (std::ostream& out, const std::string& name, const Scale& scale)
+{
+	out << "module " << name << " {\n\n";
+	types (out, scale);
+
+	// Inheritance chain
+	for (unsigned i = 0; i < scale.depth; ++i) {
+		out << "\tinterface Level" << i;
+		if (i)
+			out << " : Level" << (i - 1);
+		out << " {\n"
+			"\t\tattribute long attr" << i << ";\n";
+		operations (out, "level" + std::to_string (i) + "_", 2);
+		out << "\t};\n\n";
+	}
+
+	for (unsigned i = 0; i < scale.interfaces; ++i) {
+		out << "\tinterface Service" << i << " {\n"
+			"\t\treadonly attribute Big big;\n"
+			"\t\tattribute Variant var;\n";
+		operations (out, "op", scale.operations);
+		out << "\t};\n\n";
+	}
+
+	out << "\tvaluetype Value {\n"
+		"\t\tpublic Big data;\n"
+		"\t\tprivate LongSeq items;\n"
+		"\t\tfactory create (in long x);\n"
+		"\t\tvoid update (in Variant v);\n"
+		"\t};\n\n"
+		"\tvaluetype DerivedValue : Value {\n"
+		"\t\tpublic StringSeqSeq names;\n"
+		"\t};\n\n"
+		"\tvaluetype BoxedBig Big;\n\n";
+
+	out << "};\n\n";
+}
+
+unsigned number (const char* s)
+{
+	int n = atoi (s);
+	if (n < 0)
+		throw std::invalid_argument (std::string ("Invalid number: ") + s);
+	return (unsigned)n;
+}
+
+}
+
+int main (int argc, char* argv [])
+{
+	if (argc != 8) {
+		std::cerr << "Usage: idlgen <output directory> <files> <modules> <interfaces> <operations> <depth> <members>\n";
+		return EXIT_FAILURE;
+	}
+
+	try {
+		std::filesystem::path dir (argv [1]);
+		Scale scale { number (argv [2]), number (argv [3]), number (argv [4]),
+			number (argv [5]), number (argv [6]), number (argv [7]) };
+
+		std::filesystem::create_directories (dir);
+		uintmax_t total = 0;
+		for (unsigned f = 0; f < scale.files; ++f) {
+			std::filesystem::path file = dir / ("bench" + std::to_string (f) + ".idl");
+			{
+				std::ofstream out (file);
+				out << "// Generated by idlgen\n\n";
+				for (unsigned m = 0; m < scale.modules; ++m) {
+					module (out, "Bench" + std::to_string (f) + "_" + std::to_string (m), scale);
+				}
+				if (!out)
+					throw std::runtime_error ("Error writing file " + file.string ());
+			}
+			total += std::filesystem::file_size (file);
+		}
+
+		std::cout << "Generated " << scale.files << " files, "
+			<< scale.files * scale.modules * (scale.interfaces + scale.depth) << " interfaces, "
+			<< total << " bytes\n";
+	} catch (const std::exception& ex) {
+		std::cerr << ex.what () << std::endl;
+		return EXIT_FAILURE;
+	}
+	return EXIT_SUCCESS;
+}
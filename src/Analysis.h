@@ -0,0 +1,110 @@
+/*
+* Nirvana IDL to C++ compiler.
+*
+* This is a part of the Nirvana project.
+*
+* Author: Igor Popov
+*
+* Copyright (c) 2021 Igor Popov.
+*
+* This program is free software; you can redistribute it and/or modify
+* it under the terms of the GNU Lesser General Public License as published by
+* the Free Software Foundation; either version 3 of the License, or
+* (at your option) any later version.
+*
+* This program is distributed in the hope that it will be useful,
+* but WITHOUT ANY WARRANTY; without even the implied warranty of
+* MERCHANTABILITY or FITNESS FOR A PARTICULAR PURPOSE.  See the
+* GNU General Public License for more details.
+*
+* You should have received a copy of the GNU Lesser General Public
+* License along with this library.  If not, see <http://www.gnu.org/licenses/>.
+*
+* Send comments and/or bug reports to:
+*  popov.nirvana@gmail.com
+*/
+#ifndef NIDL2CPP_ANALYSIS_H_
+#define NIDL2CPP_ANALYSIS_H_
+#pragma once
+
+#include <assert.h>
+#include <mutex>
+#include <unordered_map>
+#include <vector>
+
+#include <idlfe/AST/CodeGen.h>
+#include <idlfe/AST/Interface.h>
+#include <idlfe/AST/ValueType.h>
+
+// Memoized properties of the AST items for one compilation.
+// Compiler owns the tables and clears them before each file.
+// The code generators reach them through the static CodeGenBase predicates,
+// so the compilation binds its analysis to each thread it runs on.
+class Analysis
+{
+public:
+	struct Properties
+	{
+		unsigned known;
+		unsigned value;
+	};
+
+	struct InterfaceInfo
+	{
+		AST::Interfaces bases;
+		bool stateless;
+		bool component;
+	};
+
+	// Value and abstract bases of value type
+	typedef std::vector <const AST::IV_Base*> Bases;
+
+	// The generators run concurrently, so the tables are guarded by the mutex.
+	// Only the member and base graph walks are memoized, they are worth the lock.
+	std::mutex mutex;
+	std::unordered_map <const AST::StructBase*, Properties> properties;
+	std::unordered_map <const AST::Interface*, InterfaceInfo> interfaces;
+	std::unordered_map <const AST::ValueType*, Bases> value_bases;
+
+	void clear ()
+	{
+		std::lock_guard <std::mutex> lock (mutex);
+		properties.clear ();
+		interfaces.clear ();
+		value_bases.clear ();
+	}
+
+	// The analysis bound to the current thread.
+	static Analysis& current () noexcept
+	{
+		assert (current_);
+		return *current_;
+	}
+
+	// Binds the analysis to the current thread for the scope lifetime.
+	class Scope
+	{
+	public:
+		Scope (Analysis& analysis) noexcept :
+			prev_ (current_)
+		{
+			current_ = &analysis;
+		}
+
+		~Scope ()
+		{
+			current_ = prev_;
+		}
+
+		Scope (const Scope&) = delete;
+		Scope& operator = (const Scope&) = delete;
+
+	private:
+		Analysis* prev_;
+	};
+
+private:
+	inline static thread_local Analysis* current_ = nullptr;
+};
+
+#endif
@@ -0,0 +1,135 @@
+/*
+* Nirvana IDL to C++ compiler.
+*
+* This is a part of the Nirvana project.
+*
+* Author: Igor Popov
+*
+* Copyright (c) 2021 Igor Popov.
+*
+* This program is free software; you can redistribute it and/or modify
+* it under the terms of the GNU Lesser General Public License as published by
+* the Free Software Foundation; either version 3 of the License, or
+* (at your option) any later version.
+*
+* This program is distributed in the hope that it will be useful,
+* but WITHOUT ANY WARRANTY; without even the implied warranty of
+* MERCHANTABILITY or FITNESS FOR A PARTICULAR PURPOSE.  See the
+* GNU General Public License for more details.
+*
+* You should have received a copy of the GNU Lesser General Public
+* License along with this library.  If not, see <http://www.gnu.org/licenses/>.
+*
+* Send comments and/or bug reports to:
+*  popov.nirvana@gmail.com
+*/
+#include "Cache.h"
+#include "Code.h"
+#include "Hash.h"
+#include <algorithm>
+#include <fstream>
+#include <iterator>
+#include <random>
+
+using std::filesystem::path;
+
+const char Cache::KEY [] = "key";
+const char Cache::INDEX [] = "index";
+
+// The key hash only names the entry, the hash collision is detected by the key comparison.
+std::string Cache::entry_name (const std::string& key)
+{
+	Hash hash;
+	hash.append (key);
+	return hash.hex ();
+}
+
+bool Cache::restore (const std::string& key, const Dirs& dirs, Paths* restored) const
+{
+	path entry = dir_ / entry_name (key);
+	{
+		std::ifstream f (entry / KEY, std::ios::binary);
+		if (!f || !std::equal (key.begin (), key.end (), std::istreambuf_iterator <char> (f),
+			std::istreambuf_iterator <char> ()))
+			return false;
+	}
+
+	std::ifstream index (entry / INDEX);
+	if (!index)
+		return false;
+
+	Paths outputs;
+	std::string line;
+	while (std::getline (index, line)) {
+		if (line.empty ())
+			continue;
+		size_t tab = line.find ('\t');
+		if (tab == std::string::npos)
+			return false;
+		auto dir = dirs.find (line.substr (0, tab));
+		if (dir == dirs.end ())
+			return false;
+		outputs.push_back (dir->second / line.substr (tab + 1));
+	}
+	if (!index.eof ())
+		return false;
+
+	std::error_code ec;
+	for (size_t i = 0; i < outputs.size (); ++i) {
+		if (!std::filesystem::is_regular_file (entry / std::to_string (i), ec))
+			return false;
+	}
+
+	for (size_t i = 0; i < outputs.size (); ++i) {
+		path tmp = Code::temp_file (outputs [i]);
+		std::filesystem::copy_file (entry / std::to_string (i), tmp,
+			std::filesystem::copy_options::overwrite_existing);
+		Code::replace_if_changed (tmp, outputs [i]);
+	}
+	if (restored)
+		restored->insert (restored->end (), outputs.begin (), outputs.end ());
+	return true;
+}
+
+void Cache::store (const std::string& key, const Dirs& dirs, const Paths& outputs) const
+{
+	std::vector <std::string> roles;
+	for (const auto& out : outputs) {
+		auto dir = dirs.begin ();
+		while (dir != dirs.end () && dir->second != out.parent_path ())
+			++dir;
+		if (dir == dirs.end ())
+			return;
+		roles.push_back (dir->first);
+	}
+
+	const std::string name = entry_name (key);
+	path entry = dir_ / name;
+	std::error_code ec;
+	if (std::filesystem::exists (entry, ec))
+		return;
+
+	// Build the entry in the temporary directory, then rename it.
+	// So the concurrent compilers never see an incomplete entry.
+	path tmp = dir_ / (name + '.' + std::to_string (std::random_device {} ()));
+	std::filesystem::create_directories (tmp);
+	try {
+		std::ofstream key_file (tmp / KEY, std::ios::binary);
+		key_file << key;
+		key_file.close ();
+		std::ofstream index (tmp / INDEX);
+		for (size_t i = 0; i < outputs.size (); ++i) {
+			index << roles [i] << '\t' << outputs [i].filename ().string () << '\n';
+			std::filesystem::copy_file (outputs [i], tmp / std::to_string (i));
+		}
+		index.close ();
+		if (!key_file || !index)
+			throw std::runtime_error ("Error writing cache entry");
+		std::filesystem::rename (tmp, entry, ec);
+		if (ec) // Another process stored the same entry
+			std::filesystem::remove_all (tmp);
+	} catch (...) {
+		std::filesystem::remove_all (tmp, ec);
+		throw;
+	}
+}
@@ -0,0 +1,70 @@
+/*
+* Nirvana IDL to C++ compiler.
+*
+* This is a part of the Nirvana project.
+*
+* Author: Igor Popov
+*
+* Copyright (c) 2021 Igor Popov.
+*
+* This program is free software; you can redistribute it and/or modify
+* it under the terms of the GNU Lesser General Public License as published by
+* the Free Software Foundation; either version 3 of the License, or
+* (at your option) any later version.
+*
+* This program is distributed in the hope that it will be useful,
+* but WITHOUT ANY WARRANTY; without even the implied warranty of
+* MERCHANTABILITY or FITNESS FOR A PARTICULAR PURPOSE.  See the
+* GNU General Public License for more details.
+*
+* You should have received a copy of the GNU Lesser General Public
+* License along with this library.  If not, see <http://www.gnu.org/licenses/>.
+*
+* Send comments and/or bug reports to:
+*  popov.nirvana@gmail.com
+*/
+#ifndef NIDL2CPP_CACHE_H_
+#define NIDL2CPP_CACHE_H_
+#pragma once
+
+#include <filesystem>
+#include <map>
+#include <string>
+#include <vector>
+
+// Content-addressed cache of the generated files.
+// Each entry is a directory named by the key hash. It contains the key itself,
+// the list of the output files and the output files themselves.
+// The output file is listed by the role of its directory and the file name,
+// so it is restored to the directory with the same role of the current compilation.
+class Cache
+{
+public:
+	typedef std::vector <std::filesystem::path> Paths;
+
+	// Output directories by role
+	typedef std::map <std::string, std::filesystem::path> Dirs;
+
+	Cache (const std::filesystem::path& dir) :
+		dir_ (dir)
+	{}
+
+	// Restore the output files from the cache.
+	// If outputs is not null, the restored file paths are appended to it.
+	// Returns `false` if the key is not found.
+	bool restore (const std::string& key, const Dirs& dirs, Paths* outputs = nullptr) const;
+
+	// Store output files to the cache.
+	// The files outside of the `dirs` are not cached.
+	void store (const std::string& key, const Dirs& dirs, const Paths& outputs) const;
+
+private:
+	static std::string entry_name (const std::string& key);
+
+	static const char KEY [];
+	static const char INDEX [];
+
+	std::filesystem::path dir_;
+};
+
+#endif
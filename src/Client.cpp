@@ -24,16 +24,171 @@
 *  popov.nirvana@gmail.com
 */
 #include "Client.h"
+#include <algorithm>
+#include <unordered_map>
 
 using std::filesystem::path;
 using namespace AST;
 
 void Client::end (const Root&)
 {
+	if (options ().client_shards) {
+		for (const auto& shard : h_.split (shard_dependencies ())) {
+			compiler ().add_generated (shard);
+		}
+	}
 	h_.close ();
 	cpp_.close ();
 }
 
+Header::ShardDeps Client::shard_dependencies () const
+{
+	const Code::Sections& sections = h_.sections ();
+
+	// The AMI types are forward declared by the interface
+	std::unordered_map <const NamedItem*, const NamedItem*> ami_owners;
+	for (const auto& ami : compiler ().ami_interfaces ()) {
+		ami_owners.emplace (ami.second.poller, ami.first);
+		ami_owners.emplace (ami.second.handler, ami.first);
+	}
+
+	// The section depends on the latest preceding section of each definition it uses,
+	// including the forward declaration of itself.
+	std::unordered_map <std::string_view, size_t> latest;
+	Header::ShardDeps deps (sections.size ());
+	std::vector <const NamedItem*> used;
+	for (size_t i = 0; i < sections.size (); ++i) {
+		const Code::Section& sec = sections [i];
+		used.clear ();
+		used_items (*sec.item, used);
+		auto owner = ami_owners.find (sec.item);
+		if (owner != ami_owners.end ())
+			used.push_back (owner->second);
+
+		std::vector <size_t>& sec_deps = deps [i];
+		auto prev = latest.find (sec.name);
+		if (prev != latest.end ())
+			sec_deps.push_back (prev->second);
+		for (const NamedItem* item : used) {
+			auto f = latest.find (top_level (*item).qualified_name ());
+			if (f != latest.end () && std::find (sec_deps.begin (), sec_deps.end (), f->second) == sec_deps.end ())
+				sec_deps.push_back (f->second);
+		}
+		latest [sec.name] = i;
+	}
+	return deps;
+}
+
+const NamedItem& Client::top_level (const NamedItem& item)
+{
+	const NamedItem* p = &item;
+	for (const NamedItem* parent; (parent = p->parent ()) && parent->kind () != Item::Kind::MODULE;) {
+		p = parent;
+	}
+	return *p;
+}
+
+void Client::used_types (const Type& type, std::vector <const NamedItem*>& used)
+{
+	switch (type.tkind ()) {
+	case Type::Kind::NAMED_TYPE:
+		used.push_back (&type.named_type ());
+		break;
+	case Type::Kind::SEQUENCE:
+		used_types (type.sequence (), used);
+		break;
+	case Type::Kind::ARRAY:
+		used_types (type.array (), used);
+		break;
+	}
+}
+
+void Client::used_items (const NamedItem& item, std::vector <const NamedItem*>& used)
+{
+	switch (item.kind ()) {
+	case Item::Kind::TYPE_DEF:
+		used_types (static_cast <const TypeDef&> (item), used);
+		break;
+
+	case Item::Kind::CONSTANT: {
+		const Constant& c = static_cast <const Constant&> (item);
+		used_types (c, used);
+		switch (c.vtype ()) {
+		case Variant::VT::ENUM_ITEM:
+			used.push_back (&c.as_enum_item ().enum_type ());
+			break;
+		case Variant::VT::CONSTANT:
+			used.push_back (&c.as_constant ());
+			break;
+		}
+	} break;
+
+	case Item::Kind::VALUE_BOX:
+		used_types (static_cast <const ValueBox&> (item), used);
+		break;
+
+	case Item::Kind::STRUCT:
+	case Item::Kind::EXCEPTION:
+		for (auto m : static_cast <const StructBase&> (item)) {
+			used_types (*m, used);
+		}
+		break;
+
+	case Item::Kind::UNION: {
+		const Union& u = static_cast <const Union&> (item);
+		used_types (u.discriminator_type (), used);
+		for (auto el : u) {
+			used_types (*el, used);
+		}
+	} break;
+
+	case Item::Kind::OPERATION: {
+		const Operation& op = static_cast <const Operation&> (item);
+		used_types (op, used);
+		for (auto par : op) {
+			used_types (*par, used);
+		}
+		used.insert (used.end (), op.raises ().begin (), op.raises ().end ());
+	} break;
+
+	case Item::Kind::ATTRIBUTE: {
+		const Attribute& att = static_cast <const Attribute&> (item);
+		used_types (att, used);
+		used.insert (used.end (), att.getraises ().begin (), att.getraises ().end ());
+		used.insert (used.end (), att.setraises ().begin (), att.setraises ().end ());
+	} break;
+
+	case Item::Kind::STATE_MEMBER:
+		used_types (static_cast <const StateMember&> (item), used);
+		break;
+
+	case Item::Kind::VALUE_FACTORY: {
+		const ValueFactory& factory = static_cast <const ValueFactory&> (item);
+		for (auto par : factory) {
+			used_types (*par, used);
+		}
+		used.insert (used.end (), factory.raises ().begin (), factory.raises ().end ());
+	} break;
+
+	case Item::Kind::INTERFACE: {
+		const Interface& itf = static_cast <const Interface&> (item);
+		used.insert (used.end (), itf.bases ().begin (), itf.bases ().end ());
+		for (auto child : itf) {
+			used_items (*child, used);
+		}
+	} break;
+
+	case Item::Kind::VALUE_TYPE: {
+		const ValueType& vt = static_cast <const ValueType&> (item);
+		used.insert (used.end (), vt.bases ().begin (), vt.bases ().end ());
+		used.insert (used.end (), vt.supports ().begin (), vt.supports ().end ());
+		for (auto child : vt) {
+			used_items (*child, used);
+		}
+	} break;
+	}
+}
+
 void Client::leaf (const Include& item)
 {
 	h_.namespace_close ();
@@ -452,7 +607,7 @@ void Client::end_interface (const IV_Base& container)
 				break;
 		}
 
-		Interfaces itf_bases = itf.get_all_bases ();
+		const Interfaces& itf_bases = get_all_bases (itf);
 		bases.assign (itf_bases.begin (), itf_bases.end ());
 		bridge_bases (bases);
 
@@ -467,7 +622,7 @@ void Client::end_interface (const IV_Base& container)
 		att_byref = true;
 		if ((concrete_itf = get_concrete_supports (vt))) {
 			supports.push_back (concrete_itf);
-			Interfaces itf_bases = concrete_itf->get_all_bases ();
+			const Interfaces& itf_bases = get_all_bases (*concrete_itf);
 			supports.insert (supports.end (), itf_bases.begin (), itf_bases.end ());
 		}
 
@@ -34,12 +34,15 @@
 class Client : public CodeGenBase
 {
 public:
-	Client (const Compiler& compiler, const AST::Root& root,
+	Client (const Compiler& compiler, std::ostream& err_out, const AST::Root& root,
 		const std::filesystem::path& file_h, const std::filesystem::path& file_cpp) :
-		CodeGenBase (compiler),
-		h_ (file_h, root),
+		CodeGenBase (compiler, err_out),
+		h_ (file_h, root, compiler.reproducible),
 		cpp_ (file_cpp, root)
 	{
+		add_output (h_, compiler.client_shards);
+		add_output (cpp_);
+
 		if (!compiler.inc_cpp.empty ())
 			cpp_ << "#include \"" << compiler.inc_cpp << "\"\n";
 
@@ -215,6 +218,12 @@ private:
 
 	void generate_ami (const AST::Interface& itf);
 
+	// Header shards
+	Header::ShardDeps shard_dependencies () const;
+	static const AST::NamedItem& top_level (const AST::NamedItem& item);
+	static void used_items (const AST::NamedItem& item, std::vector <const AST::NamedItem*>& used);
+	static void used_types (const AST::Type& type, std::vector <const AST::NamedItem*>& used);
+
 	void override_sendp (const AST::Interface& itf, const AST::ValueType& poller);
 
 	void traits_begin (const AST::ItemWithId& item);
@@ -25,37 +25,194 @@
 */
 #include "Code.h"
 #include "CodeGenBase.h"
+#include "Hash.h"
+#include <algorithm>
+#include <fstream>
+#include <string.h>
 
 using std::filesystem::path;
 using namespace AST;
 
-#ifdef _WIN32
-#define DEVNULL ".\\nul"
-#else
-#define DEVNULL "/dev/null"
-#endif
-
-Code::Code ()
-{}
+Code::Code () :
+	Base (nullptr),
+	open_ (false),
+	sections_enabled_ (false),
+	fingerprints_ (false),
+	fingerprints_written_ (false),
+	self_contained_ (false)
+{
+	rdbuf (&buf_);
+}
 
-Code::Code (const path& file, const Root& root)
+Code::Code (const path& file, const Root& root) :
+	Code ()
 {
 	open (file, root);
 }
 
 Code::~Code ()
 {
-	if (is_open ()) {
-		Base::close ();
-		if (!file_.empty ())
-			remove (file_);
+	// Generation failed, remove the outdated file
+	if (is_open () && !file_.empty ()) {
+		std::error_code ec;
+		remove (file_, ec);
+		if (fingerprints_)
+			remove (fingerprint_file (file_), ec);
+		for (const auto& shard : shards_) {
+			remove (shard, ec);
+		}
+	}
+}
+
+void Code::Buffer::reset ()
+{
+	data_.clear ();
+	data_.reserve (256 * 1024);
+	indentation_ = 0;
+	bol_ = true;
+}
+
+void Code::Buffer::append (const char* s, size_t n)
+{
+	const char* end = s + n;
+	while (s < end) {
+		if (bol_ && '\n' != *s)
+			data_.append (indentation_, '\t');
+		const char* eol = (const char*)memchr (s, '\n', end - s);
+		if (eol) {
+			++eol;
+			data_.append (s, eol);
+			bol_ = true;
+			s = eol;
+		} else {
+			data_.append (s, end);
+			bol_ = false;
+			break;
+		}
+	}
+}
+
+Code::Buffer::int_type Code::Buffer::overflow (int_type c)
+{
+	if (!traits_type::eq_int_type (c, traits_type::eof ())) {
+		char ch = traits_type::to_char_type (c);
+		append (&ch, 1);
+	}
+	return traits_type::not_eof (c);
+}
+
+std::streamsize Code::Buffer::xsputn (const char* s, std::streamsize n)
+{
+	append (s, (size_t)n);
+	return n;
+}
+
+void Code::Buffer::empty_line ()
+{
+	size_t size = data_.size ();
+	if (size) {
+		if ('\n' != data_ [size - 1])
+			data_ += "\n\n";
+		else if (size < 2 || '\n' != data_ [size - 2])
+			data_ += '\n';
+		bol_ = true;
+	}
+}
+
+path Code::temp_file (const path& file)
+{
+	path tmp (file);
+	tmp += ".tmp";
+	return tmp;
+}
+
+bool Code::same_content (const path& f1, const path& f2)
+{
+	std::error_code ec;
+	auto size = std::filesystem::file_size (f1, ec);
+	if (ec || size != std::filesystem::file_size (f2, ec) || ec)
+		return false;
+
+	std::ifstream s1 (f1, std::ios::binary), s2 (f2, std::ios::binary);
+	char buf1 [4096], buf2 [4096];
+	while (s1 && s2) {
+		s1.read (buf1, sizeof (buf1));
+		s2.read (buf2, sizeof (buf2));
+		if (s1.gcount () != s2.gcount ()
+			|| !std::equal (buf1, buf1 + s1.gcount (), buf2))
+			return false;
+	}
+	return s1.eof () && s2.eof ();
+}
+
+bool Code::same_content (const path& file, std::string_view content)
+{
+	// The output is written in text mode, so on Windows the file size differs.
+#ifndef _WIN32
+	std::error_code ec;
+	if (std::filesystem::file_size (file, ec) != content.size () || ec)
+		return false;
+#endif
+
+	std::ifstream f (file);
+	if (!f)
+		return false;
+	char buf [4096];
+	while (f) {
+		f.read (buf, sizeof (buf));
+		size_t cb = (size_t)f.gcount ();
+		if (cb > content.size () || !std::equal (buf, buf + cb, content.begin ()))
+			return false;
+		content.remove_prefix (cb);
+	}
+	return f.eof () && content.empty ();
+}
+
+bool Code::write_if_changed (const path& file, std::string_view content)
+{
+	if (same_content (file, content))
+		return false;
+
+	// Write to the temporary file and rename it,
+	// so the target is never left partially written.
+	path tmp = temp_file (file);
+	{
+		std::ofstream f (tmp);
+		f.write (content.data (), content.size ());
+		f.close ();
+		if (!f) {
+			std::error_code ec;
+			remove (tmp, ec);
+			throw std::runtime_error ("Error writing file " + tmp.string ());
+		}
+	}
+	std::filesystem::rename (tmp, file);
+	return true;
+}
+
+bool Code::replace_if_changed (const path& src, const path& dst)
+{
+	if (same_content (src, dst)) {
+		remove (src);
+		return false;
+	} else {
+		std::filesystem::rename (src, dst);
+		return true;
 	}
 }
 
 void Code::open (const path& file, const Root& root)
 {
-	Base::open (file.empty () ? DEVNULL : file);
+	// The target is replaced on close only if the content was changed.
+	// So the file timestamp is preserved and the dependent sources are not rebuilt.
+	buf_.reset ();
+	clear ();
+	open_ = true;
 	cur_namespace_.clear ();
+	module_namespaces_.clear ();
+	sections_.clear ();
+	fingerprints_written_ = false;
+	shards_.clear ();
 	file_ = file;
 	*this << "// This file was generated from " << root.file ().filename () << std::endl;
 	*this << "// " << Compiler::name_ << " version ";
@@ -70,7 +227,157 @@ void Code::open (const path& file, const Root& root)
 void Code::close ()
 {
 	namespace_close ();
-	Base::close ();
+	open_ = false;
+	if (!file_.empty ()) {
+		write_if_changed (file_, buf_.data ());
+		write_fingerprints ();
+	}
+}
+
+void Code::section_begin (const NamedItem& item)
+{
+	if (sections_enabled_) {
+		assert (sections_.empty () || sections_.back ().end != std::string::npos);
+		if (self_contained_)
+			namespace_close ();
+		sections_.push_back ({ &item, item.qualified_name (), buf_.data ().size (), std::string::npos });
+	}
+}
+
+void Code::section_end ()
+{
+	if (sections_enabled_) {
+		assert (!sections_.empty () && sections_.back ().end == std::string::npos);
+		if (self_contained_)
+			namespace_close ();
+		sections_.back ().end = buf_.data ().size ();
+	}
+}
+
+void Code::replace_content (std::string_view content)
+{
+	buf_.reset ();
+	sections_.clear ();
+	namespace_marks_.clear ();
+	write (content.data (), content.size ());
+}
+
+void Code::split (const std::vector <path>& files, const std::vector <unsigned>& shards)
+{
+	assert (!files.empty () && files.front () == file_);
+	assert (shards.size () == sections_.size ());
+	const std::string& text = buf_.data ();
+
+	const size_t preamble = sections_.empty () ? text.size () : sections_.front ().begin;
+	std::vector <std::string> contents (files.size (), std::string (text, 0, preamble));
+	size_t pos = preamble;
+	for (size_t i = 0; i < sections_.size (); ++i) {
+		const Section& sec = sections_ [i];
+		assert (shards [i] < files.size ());
+		contents.front ().append (text, pos, sec.begin - pos);
+		contents [shards [i]].append (text, sec.begin, sec.end - sec.begin);
+		pos = sec.end;
+	}
+	contents.front ().append (text, pos, std::string::npos);
+
+	// The fingerprints describe the definitions, they are written before the sections move.
+	write_fingerprints ();
+	for (size_t i = 1; i < files.size (); ++i) {
+		add_shard (files [i]);
+		write_if_changed (files [i], contents [i]);
+	}
+	replace_content (contents.front ());
+}
+
+void Code::hash_text (Hash& hash, size_t begin, size_t end) const
+{
+	const std::string& data = buf_.data ();
+
+	// The first mark ending after begin
+	auto mark = std::upper_bound (namespace_marks_.begin (), namespace_marks_.end (), begin,
+		[] (size_t pos, const NamespaceMark& m) { return pos < m.end; });
+
+	// The namespace is hashed before the text in it,
+	// so the namespace lines without text do not matter.
+	std::string_view ns;
+	if (mark != namespace_marks_.begin ())
+		ns = (mark - 1)->path;
+	bool ns_hashed = false;
+	auto append = [&] (size_t b, size_t e) {
+		if (b < e) {
+			if (!ns_hashed) {
+				hash.append (ns);
+				ns_hashed = true;
+			}
+			hash.append (data.data () + b, e - b);
+		}
+	};
+
+	size_t pos = begin;
+	for (; mark != namespace_marks_.end () && mark->begin < end; ++mark) {
+		append (pos, mark->begin);
+		if (ns != mark->path) {
+			ns = mark->path;
+			ns_hashed = false;
+		}
+		pos = std::max (pos, std::min (mark->end, end));
+	}
+	append (pos, end);
+}
+
+void Code::namespace_mark (size_t begin)
+{
+	if (fingerprints_) {
+		std::string path;
+		for (const auto& ns : cur_namespace_) {
+			path += "::";
+			path += ns;
+		}
+		namespace_marks_.push_back ({ begin, buf_.data ().size (), std::move (path) });
+	}
+}
+
+path Code::fingerprint_file (const path& file)
+{
+	path fp = file;
+	fp += ".fp";
+	return fp;
+}
+
+void Code::write_fingerprints ()
+{
+	if (!fingerprints_ || fingerprints_written_)
+		return;
+
+	// One line per definition: "<hash> <qualified name>".
+	// A definition may have several sections, for example, the forward declaration.
+	// The code outside the sections goes to the last line with name "::".
+	// The namespace lines are not hashed, they depend on the neighbour sections.
+	std::vector <std::pair <std::string_view, Hash> > entries;
+	std::unordered_map <std::string_view, size_t> index;
+	Hash global;
+	size_t pos = 0;
+	for (const Section& sec : sections_) {
+		hash_text (global, pos, sec.begin);
+		auto ins = index.emplace (sec.name, entries.size ());
+		if (ins.second)
+			entries.emplace_back (sec.name, Hash ());
+		hash_text (entries [ins.first->second].second, sec.begin, sec.end);
+		pos = sec.end;
+	}
+	hash_text (global, pos, buf_.data ().size ());
+
+	std::string content;
+	for (const auto& e : entries) {
+		content += e.second.hex ();
+		content += ' ';
+		content += e.first;
+		content += '\n';
+	}
+	content += global.hex ();
+	content += " ::\n";
+	write_if_changed (fingerprint_file (file_), content);
+	fingerprints_written_ = true;
 }
 
 void Code::include_header (const path& file_h)
@@ -85,39 +392,50 @@ void Code::include_header (const path& file_h)
 
 void Code::namespace_open (const char* ns)
 {
-	Namespaces nsv;
-	get_namespace (ns, nsv);
-	namespace_open (nsv);
+	namespace_open (get_namespace (ns));
 }
 
 void Code::namespace_open (const NamedItem& item)
 {
-	Namespaces ns;
-	get_namespace (item, ns);
-	namespace_open (ns);
+	namespace_open (get_namespace (item));
 }
 
-void Code::get_namespace (const NamedItem& item, Namespaces& ns)
+const Code::Namespaces& Code::get_namespace (const NamedItem& item)
 {
 	auto p = item.parent ();
 	while (p && p->kind () != Item::Kind::MODULE)
 		p = p->parent ();
 
-	get_namespace (static_cast <const Module*> (p), ns);
+	return get_namespace (static_cast <const Module*> (p));
 }
 
-void Code::get_namespace (const Module* mod, Namespaces& ns)
+const Code::Namespaces& Code::get_namespace (const Module* mod)
 {
+	auto f = module_namespaces_.find (mod);
+	if (f != module_namespaces_.end ())
+		return f->second;
+
+	Namespaces ns;
 	if (mod) {
 		assert (mod->kind () == Item::Kind::MODULE);
-		get_namespace (static_cast <const Module*> (mod->parent ()), ns);
+		ns = get_namespace (static_cast <const Module*> (mod->parent ()));
 		ns.emplace_back (mod->name ());
 	}
+	return module_namespaces_.emplace (mod, std::move (ns)).first->second;
 }
 
-void Code::get_namespace (const char* s, Namespaces& ns)
+const Code::Namespaces& Code::get_namespace (const char* ns_str)
 {
-	if (s && *s) {
+	if (!ns_str)
+		ns_str = "";
+	auto f = string_namespaces_.find (std::string_view (ns_str));
+	if (f != string_namespaces_.end ())
+		return f->second;
+
+	f = string_namespaces_.emplace (ns_str, Namespaces ()).first;
+	const char* s = f->first.c_str ();
+	Namespaces& ns = f->second;
+	if (*s) {
 		for (;;) {
 			const char* end = strchr (s, '/');
 			if (end) {
@@ -129,38 +447,35 @@ void Code::get_namespace (const char* s, Namespaces& ns)
 			}
 		}
 	}
+	return ns;
 }
 
 void Code::namespace_close ()
 {
 	if (!cur_namespace_.empty ()) {
+		const size_t begin = buf_.data ().size ();
 		empty_line ();
 		for (size_t cnt = cur_namespace_.size (); cnt; --cnt) {
 			*this << "}\n";
 		}
 		cur_namespace_.clear ();
+		namespace_mark (begin);
 	}
 }
 
 void Code::namespace_prefix (const AST::NamedItem& item)
 {
-	Namespaces ns;
-	get_namespace (item, ns);
-	namespace_prefix (ns);
+	namespace_prefix (get_namespace (item));
 }
 
 void Code::namespace_prefix (const Module* mod)
 {
-	Namespaces ns;
-	get_namespace (mod, ns);
-	namespace_prefix (ns);
+	namespace_prefix (get_namespace (mod));
 }
 
 void Code::namespace_prefix (const char* ns)
 {
-	Namespaces nsv;
-	get_namespace (ns, nsv);
-	namespace_prefix (nsv);
+	namespace_prefix (get_namespace (ns));
 }
 
 void Code::namespace_open (const Namespaces& ns)
@@ -171,6 +486,7 @@ void Code::namespace_open (const Namespaces& ns)
 			break;
 	}
 	if (cur != cur_namespace_.end () || req != ns.end ()) {
+		const size_t begin = buf_.data ().size ();
 		empty_line ();
 		for (size_t cnt = cur_namespace_.end () - cur; cnt; --cnt) {
 			*this << "}\n";
@@ -182,6 +498,7 @@ void Code::namespace_open (const Namespaces& ns)
 			cur_namespace_.push_back (*req);
 		}
 		*this << std::endl;
+		namespace_mark (begin);
 	}
 }
 
@@ -220,28 +537,28 @@ void Code::check_digraph (char c)
 Code& operator << (Code& stm, char c)
 {
 	stm.check_digraph (c);
-	static_cast <BE::IndentedOut&> (stm) << c;
+	static_cast <std::ostream&> (stm) << c;
 	return stm;
 }
 
 Code& operator << (Code& stm, signed char c)
 {
 	stm.check_digraph (c);
-	static_cast <BE::IndentedOut&> (stm) << c;
+	static_cast <std::ostream&> (stm) << c;
 	return stm;
 }
 
 Code& operator << (Code& stm, unsigned char c)
 {
 	stm.check_digraph (c);
-	static_cast <BE::IndentedOut&> (stm) << c;
+	static_cast <std::ostream&> (stm) << c;
 	return stm;
 }
 
 Code& operator << (Code& stm, const char* s)
 {
 	stm.check_digraph (*s);
-	static_cast <BE::IndentedOut&> (stm) << s;
+	static_cast <std::ostream&> (stm) << s;
 	return stm;
 }
 
@@ -438,6 +755,17 @@ Code& operator << (Code& stm, const QName& qn)
 	return stm << ParentName (qn.item) << qn.item.name ();
 }
 
+Code& operator << (Code& stm, const ScopedNameOf& sn)
+{
+	const NamedItem* parent = sn.item.parent ();
+	if (parent)
+		stm << ScopedNameOf (*parent, sn.separator) << sn.separator;
+
+	// The raw name, without the protected prefix. The names are used in the repository ids
+	// and the exported symbols, which must not change.
+	return stm << static_cast <const std::string&> (sn.item.name ());
+}
+
 Code& operator << (Code& stm, const ParentName& qn)
 {
 	const NamedItem* parent = qn.item.parent ();
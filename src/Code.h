@@ -27,7 +27,12 @@
 #define NIDL2CPP_CODE_H_
 #pragma once
 
+#include <map>
+#include <ostream>
+#include <string>
 #include <string_view>
+#include <unordered_map>
+#include <vector>
 
 #include <idlfe/AST/Root.h>
 #include <idlfe/AST/Module.h>
@@ -37,12 +42,13 @@
 #include <idlfe/AST/Operation.h>
 #include <idlfe/AST/StateMember.h>
 
-#include <idlfe/BE/IndentedOut.h>
+class Hash;
 
 // C++ code file output.
-class Code : public BE::IndentedOut
+// The code is collected in memory and written to the file at once on close.
+class Code : public std::ostream
 {
-	typedef BE::IndentedOut Base;
+	typedef std::ostream Base;
 public:
 	Code ();
 	Code (const std::filesystem::path& file, const AST::Root& root);
@@ -51,6 +57,32 @@ public:
 	void open (const std::filesystem::path& file, const AST::Root& root);
 	void close ();
 
+	bool is_open () const noexcept
+	{
+		return open_;
+	}
+
+	void indent ()
+	{
+		buf_.indent ();
+	}
+
+	void unindent ()
+	{
+		buf_.unindent ();
+	}
+
+	// Insert an empty line if the last line is not empty.
+	void empty_line ()
+	{
+		buf_.empty_line ();
+	}
+
+	char last_char () const noexcept
+	{
+		return buf_.last_char ();
+	}
+
 	const std::filesystem::path& file () const
 	{
 		return file_;
@@ -58,6 +90,48 @@ public:
 
 	void include_header (const std::filesystem::path& file_h);
 
+	// The code generated for each top-level definition is a section.
+	// If fingerprints is `true`, the section fingerprints are written
+	// to the fingerprint file on close.
+	// If self_contained is `true`, the namespaces are closed at the section bounds.
+	void enable_sections (bool fingerprints, bool self_contained) noexcept
+	{
+		sections_enabled_ = true;
+		fingerprints_ = fingerprints;
+		self_contained_ = self_contained;
+	}
+
+	void section_begin (const AST::NamedItem& item);
+	void section_end ();
+
+	struct Section
+	{
+		const AST::NamedItem* item;
+		std::string name;
+		size_t begin, end;
+	};
+
+	typedef std::vector <Section> Sections;
+
+	const Sections& sections () const noexcept
+	{
+		return sections_;
+	}
+
+	// The code collected so far.
+	const std::string& content () const noexcept
+	{
+		return buf_.data ();
+	}
+
+	// Move the sections to the other files.
+	// files [0] is this file, shards [i] is the file index for the section i.
+	// Each file starts with the code preceding the first section, the include directives.
+	// The code between the sections stays in this file.
+	void split (const std::vector <std::filesystem::path>& files, const std::vector <unsigned>& shards);
+
+	static std::filesystem::path fingerprint_file (const std::filesystem::path& file);
+
 	void namespace_open (const AST::NamedItem& item);
 	void namespace_open (const char* ns);
 	void namespace_close ();
@@ -164,16 +238,123 @@ public:
 
 	void check_digraph (char c);
 
+	// Move src file to dst if the dst does not exist or has a different content.
+	// Otherwise remove src and leave dst untouched.
+	// Returns `true` if dst was replaced.
+	static bool replace_if_changed (const std::filesystem::path& src, const std::filesystem::path& dst);
+
+	// Temporary file for the output target.
+	static std::filesystem::path temp_file (const std::filesystem::path& file);
+
+	// Write content to the file if the file does not exist or has a different content.
+	// Returns `true` if the file was written.
+	static bool write_if_changed (const std::filesystem::path& file, std::string_view content);
+
+protected:
+	// Replace the collected code. The sections are cleared.
+	void replace_content (std::string_view content);
+
+	// Write the section fingerprints, if enabled, before the sections are moved out.
+	// Then close () does not overwrite them.
+	void write_fingerprints ();
+
+	// Hash the text excluding the namespace open and close lines, which depend on
+	// the neighbour sections. The namespace path is hashed instead.
+	void hash_text (Hash& hash, size_t begin, size_t end) const;
+
+	// Record the namespace open and close lines written from `begin`.
+	void namespace_mark (size_t begin);
+
+	// Register the file written with the sections of this file.
+	// The shards are removed with this file if the generation fails.
+	void add_shard (const std::filesystem::path& file)
+	{
+		shards_.push_back (file);
+	}
+
 private:
+	static bool same_content (const std::filesystem::path& f1, const std::filesystem::path& f2);
+	static bool same_content (const std::filesystem::path& file, std::string_view content);
+
+	// Stream buffer appending to the string and indenting the lines.
+	class Buffer : public std::streambuf
+	{
+	public:
+		Buffer () :
+			indentation_ (0),
+			bol_ (true)
+		{}
+
+		void reset ();
+
+		const std::string& data () const noexcept
+		{
+			return data_;
+		}
+
+		void indent ()
+		{
+			++indentation_;
+		}
+
+		void unindent ()
+		{
+			assert (indentation_ > 0);
+			--indentation_;
+		}
+
+		void empty_line ();
+
+		char last_char () const noexcept
+		{
+			return data_.empty () ? 0 : data_.back ();
+		}
+
+	protected:
+		virtual int_type overflow (int_type c) override;
+		virtual std::streamsize xsputn (const char* s, std::streamsize n) override;
+
+	private:
+		void append (const char* s, size_t n);
+
+	private:
+		std::string data_;
+		unsigned indentation_;
+		bool bol_;
+	};
+
 	void namespace_open (const Namespaces& ns);
 	void namespace_prefix (const Namespaces& ns);
-	static void get_namespace (const AST::NamedItem& item, Namespaces& ns);
-	static void get_namespace (const AST::Module* item, Namespaces& ns);
-	static void get_namespace (const char* s, Namespaces& ns);
+	const Namespaces& get_namespace (const AST::NamedItem& item);
+	const Namespaces& get_namespace (const AST::Module* mod);
+	const Namespaces& get_namespace (const char* s);
 
 private:
+	Buffer buf_;
+	bool open_;
 	Namespaces cur_namespace_;
 	std::filesystem::path file_;
+
+	Sections sections_;
+	bool sections_enabled_;
+	bool fingerprints_;
+	bool fingerprints_written_;
+	bool self_contained_;
+
+	// Namespace open and close lines, for the fingerprints
+	struct NamespaceMark
+	{
+		size_t begin, end;
+		std::string path; // The namespace after the lines
+	};
+
+	std::vector <NamespaceMark> namespace_marks_;
+	std::vector <std::filesystem::path> shards_;
+
+	// The namespace vectors are built once per module and per string.
+	// The string namespaces refer to the map keys.
+	std::unordered_map <const AST::Module*, Namespaces> module_namespaces_;
+	std::map <std::string, Namespaces, std::less <> > string_namespaces_;
 };
 
 Code& operator << (Code& stm, char c);
@@ -184,21 +365,21 @@ Code& operator << (Code& stm, const char* s);
 inline
 Code& operator << (Code& stm, const std::string& s)
 {
-	static_cast <BE::IndentedOut&> (stm) << s;
+	static_cast <std::ostream&> (stm) << s;
 	return stm;
 }
 
 inline
 Code& operator << (Code& stm, const std::string_view& s)
 {
-	static_cast <BE::IndentedOut&> (stm) << s;
+	static_cast <std::ostream&> (stm) << s;
 	return stm;
 }
 
 inline
 Code& operator << (Code& stm, const std::filesystem::path& s)
 {
-	static_cast <BE::IndentedOut&> (stm) << s;
+	static_cast <std::ostream&> (stm) << s;
 	return stm;
 }
 
@@ -247,6 +428,22 @@ struct ParentName
 
 Code& operator << (Code& stm, const ParentName& qn);
 
+// IDL names of the item scopes and the item name, delimited by the separator.
+// The C++ keywords are not prefixed.
+// Written directly, without the temporary ScopedName.
+struct ScopedNameOf
+{
+	ScopedNameOf (const AST::NamedItem& ni, char sep) :
+		item (ni),
+		separator (sep)
+	{}
+
+	const AST::NamedItem& item;
+	char separator;
+};
+
+Code& operator << (Code& stm, const ScopedNameOf& sn);
+
 struct TypePrefix
 {
 	TypePrefix (const AST::Type& t) :
@@ -122,9 +122,11 @@ const char* const CodeGenBase::protected_names_ [] = {
 	"xor_eq"
 };
 
-bool CodeGenBase::is_keyword (const Identifier& id)
+bool CodeGenBase::is_keyword (std::string_view id)
 {
-	return std::binary_search (protected_names_, std::end (protected_names_), id.c_str (), pred);
+	// The protected names are not sorted, so the hash lookup is used instead of the binary search.
+	static const std::unordered_set <std::string_view> keywords (std::begin (protected_names_), std::end (protected_names_));
+	return keywords.find (id) != keywords.end ();
 }
 
 bool CodeGenBase::is_var_len (const Type& type)
@@ -163,10 +165,9 @@ bool CodeGenBase::is_var_len (const Type& type)
 					return is_native_interface (item);
 
 				case Item::Kind::STRUCT:
-					return is_var_len (static_cast <const Struct&> (item));
-
 				case Item::Kind::UNION:
-					return is_var_len (static_cast <const Union&> (item));
+					return property (static_cast <const StructBase&> (item), PROP_VAR_LEN,
+						[] (const StructBase& sb) { return is_var_len (sb); });
 
 				default:
 					return false;
@@ -211,24 +212,44 @@ bool CodeGenBase::is_CDR (const Type& type, SizeAndAlign& sa)
 			return true;
 
 		case Type::Kind::ARRAY: {
+			// Each element occupies at least one byte, so the total count
+			// exceeding the size limit means overflow.
+			static const uint64_t MAX_SIZE = std::numeric_limits <unsigned>::max () - 1;
 			const Array& ar = t.array ();
-			auto cnt = 1;
+			uint64_t cnt = 1;
 			for (auto d : ar.dimensions ()) {
 				cnt *= d;
+				if (cnt > MAX_SIZE)
+					break;
 			}
-			for (; cnt; --cnt) {
+			if (cnt > MAX_SIZE)
+				break;
+
+			// The first element may break on the alignment gap.
+			if (!is_CDR (ar, sa))
+				break;
+			if (cnt > 1) {
+				// After the first element the alignment is enough for all the members,
+				// and the offset modulo maximal member alignment does not change.
+				// So each next element adds the same stride.
+				uint64_t first_end = sa.size;
 				if (!is_CDR (ar, sa))
 					break;
+				uint64_t stride = sa.size - first_end;
+				uint64_t rest = cnt - 2;
+				if (stride && rest > (MAX_SIZE - sa.size) / stride)
+					break;
+				sa.size = (unsigned)(sa.size + rest * stride);
 			}
-			if (!cnt)
-				return true;
-		} break;
+			return true;
+		}
 
 		case Type::Kind::NAMED_TYPE: {
 			const NamedItem& item = t.named_type ();
 			switch (item.kind ()) {
 				case Item::Kind::STRUCT:
-					if (is_CDR (static_cast <const Struct&> (item), sa))
+					// Fast fail for the structures which can't be CDR with any alignment
+					if (may_be_CDR (t) && is_CDR (static_cast <const Struct&> (item), sa))
 						return true;
 					break;
 
@@ -241,6 +262,97 @@ bool CodeGenBase::is_CDR (const Type& type, SizeAndAlign& sa)
 	return false;
 }
 
+bool CodeGenBase::may_be_CDR (const Type& type)
+{
+	const Type& t = type.dereference_type ();
+	switch (t.tkind ()) {
+		case Type::Kind::BASIC_TYPE:
+			switch (t.basic_type ()) {
+				case BasicType::BOOLEAN:
+				case BasicType::OCTET:
+				case BasicType::CHAR:
+				case BasicType::USHORT:
+				case BasicType::SHORT:
+				case BasicType::ULONG:
+				case BasicType::LONG:
+				case BasicType::FLOAT:
+				case BasicType::ULONGLONG:
+				case BasicType::LONGLONG:
+				case BasicType::DOUBLE:
+				case BasicType::LONGDOUBLE:
+					return true;
+			}
+			break;
+
+		case Type::Kind::FIXED:
+			return true;
+
+		case Type::Kind::ARRAY:
+			return may_be_CDR (t.array ());
+
+		case Type::Kind::NAMED_TYPE: {
+			const NamedItem& item = t.named_type ();
+			switch (item.kind ()) {
+				case Item::Kind::STRUCT:
+					return property (static_cast <const StructBase&> (item), PROP_MAY_BE_CDR,
+						[] (const StructBase& sb) {
+							for (const Member* m : sb) {
+								if (!may_be_CDR (*m))
+									return false;
+							}
+							return true;
+						});
+
+				case Item::Kind::ENUM:
+					return true;
+			}
+		}
+	}
+	return false;
+}
+
+bool CodeGenBase::property (const StructBase& item, Property prop, bool (*calc) (const StructBase&))
+{
+	Analysis& analysis = Analysis::current ();
+	{
+		std::lock_guard <std::mutex> lock (analysis.mutex);
+		auto f = analysis.properties.find (&item);
+		if (f != analysis.properties.end () && (f->second.known & prop))
+			return (f->second.value & prop) != 0;
+	}
+
+	// Calculate outside the lock because calc may recurse here.
+	bool value = calc (item);
+
+	std::lock_guard <std::mutex> lock (analysis.mutex);
+	Analysis::Properties& p = analysis.properties.emplace (&item, Analysis::Properties { 0, 0 }).first->second;
+	p.known |= prop;
+	if (value)
+		p.value |= prop;
+	return value;
+}
+
+void CodeGenBase::add_output (Code& code, bool self_contained)
+{
+	if (options ().fingerprints || self_contained)
+		code.enable_sections (options ().fingerprints, self_contained);
+	outputs_.push_back (&code);
+}
+
+void CodeGenBase::section_begin (const NamedItem& item)
+{
+	for (Code* code : outputs_) {
+		code->section_begin (item);
+	}
+}
+
+void CodeGenBase::section_end ()
+{
+	for (Code* code : outputs_) {
+		code->section_end ();
+	}
+}
+
 bool CodeGenBase::is_var_len (const Members& members)
 {
 	for (const auto& member : members) {
@@ -366,13 +478,15 @@ bool CodeGenBase::is_complex_type(const Type& type)
 					return true;
 
 				case Item::Kind::STRUCT:
-				case Item::Kind::UNION: {
-					const StructBase& sb = static_cast <const StructBase&> (item);
-					for (const Member* m : sb) {
-						if (is_complex_type (*m))
-							return true;
-					}
-				}
+				case Item::Kind::UNION:
+					return property (static_cast <const StructBase&> (item), PROP_COMPLEX,
+						[] (const StructBase& sb) {
+							for (const Member* m : sb) {
+								if (is_complex_type (*m))
+									return true;
+							}
+							return false;
+						});
 			}
 		} break;
 	}
@@ -499,24 +613,45 @@ CodeGenBase::StateMembers CodeGenBase::get_members (const ValueType& cont)
 	return ret;
 }
 
-CodeGenBase::Bases CodeGenBase::get_all_bases (const ValueType& vt)
+const CodeGenBase::Bases& CodeGenBase::get_all_bases (const ValueType& vt)
 {
-	Bases bvec;
-	{
-		std::unordered_set <const IV_Base*> bset;
-		get_all_bases (vt, bset, bvec);
-	}
-	const Interface* itf = get_concrete_supports (vt);
-	if (itf) {
-		Interfaces exclude = itf->get_all_bases ();
-		for (auto it = bvec.begin (); it != bvec.end ();) {
-			if (find (exclude.begin (), exclude.end (), *it) != exclude.end ())
-				it = bvec.erase (it);
-			else
-				++it;
+	return memoize (&Analysis::value_bases, vt, [] (const ValueType& vt) {
+		Bases bvec;
+		{
+			std::unordered_set <const IV_Base*> bset;
+			get_all_bases (vt, bset, bvec);
 		}
-	}
-	return bvec;
+		const Interface* itf = get_concrete_supports (vt);
+		if (itf) {
+			const Interfaces& exclude = get_all_bases (*itf);
+			for (auto it = bvec.begin (); it != bvec.end ();) {
+				if (find (exclude.begin (), exclude.end (), *it) != exclude.end ())
+					it = bvec.erase (it);
+				else
+					++it;
+			}
+		}
+		return bvec;
+	});
+}
+
+const Interfaces& CodeGenBase::get_all_bases (const Interface& itf)
+{
+	return interface_info (itf).bases;
+}
+
+const CodeGenBase::InterfaceInfo& CodeGenBase::interface_info (const Interface& itf)
+{
+	return memoize (&Analysis::interfaces, itf, [] (const Interface& itf) {
+		InterfaceInfo info { itf.get_all_bases (), is_special_base (itf) || is_immutable (itf), false };
+		for (auto base : info.bases) {
+			if (is_special_base (*base))
+				info.stateless = true;
+			if (base->qualified_name () == "::Components::CCMObject")
+				info.component = true;
+		}
+		return info;
+	});
 }
 
 void CodeGenBase::get_all_bases (const ValueType& vt,
@@ -728,19 +863,9 @@ bool CodeGenBase::is_immutable (const Interface& itf) noexcept
 	return false;
 }
 
-bool CodeGenBase::is_stateless (const Interface& itf) noexcept
+bool CodeGenBase::is_stateless (const Interface& itf)
 {
-	bool stateless = is_special_base (itf) || is_immutable (itf);
-	if (!stateless) {
-		Interfaces bases = itf.get_all_bases ();
-		for (auto base : bases) {
-			if (is_special_base (*base)) {
-				stateless = true;
-				break;
-			}
-		}
-	}
-	return stateless;
+	return interface_info (itf).stateless;
 }
 
 bool CodeGenBase::is_custom (const Operation& op) noexcept
@@ -781,7 +906,7 @@ bool CodeGenBase::is_named_type (const AST::Type& type, const char* qualified_na
 		&& t.named_type ().qualified_name () == qualified_name;
 }
 
-bool CodeGenBase::async_supported (const Interface& itf) noexcept
+bool CodeGenBase::async_supported (const Interface& itf)
 {
 	if (itf.interface_kind () == InterfaceKind::UNCONSTRAINED) {
 
@@ -805,18 +930,6 @@ bool CodeGenBase::async_supported (const Interface& itf) noexcept
 	return false;
 }
 
-std::string CodeGenBase::const_id (const Constant& c)
-{
-	ScopedName sn = c.scoped_name ();
-	ScopedName::const_iterator n = sn.begin ();
-	std::string name = *n;
-	for (++n; n != sn.end (); ++n) {
-		name += '/';
-		name += *n;
-	}
-	return name;
-}
-
 std::string CodeGenBase::skip_prefix (const AST::Identifier& id, const char* prefix)
 {
 	size_t cc = strlen (prefix);
@@ -826,16 +939,9 @@ std::string CodeGenBase::skip_prefix (const AST::Identifier& id, const char* pre
 		return std::string ();
 }
 
-bool CodeGenBase::is_component (const AST::Interface& itf) noexcept
+bool CodeGenBase::is_component (const AST::Interface& itf)
 {
-	Interfaces bases = itf.get_all_bases ();
-	for (const auto b : bases) {
-		if (b->qualified_name () == "::Components::CCMObject") {
-			return true;
-			break;
-		}
-	}
-	return false;
+	return interface_info (itf).component;
 }
 
 bool CodeGenBase::SizeAndAlign::append (unsigned member_align, unsigned member_size) noexcept
@@ -28,8 +28,11 @@
 #pragma once
 
 #include <string.h>
+#include <mutex>
+#include <unordered_map>
 #include <unordered_set>
 
+#include "Analysis.h"
 #include "Compiler.h"
 #include "Code.h"
 #include "Compiler.h"
@@ -64,7 +67,8 @@ class CodeGenBase :
 	public BE::MessageOut
 {
 public:
-	static bool is_keyword (const AST::Identifier& id);
+	static bool is_keyword (std::string_view id);
+
 	inline static const char protected_prefix_ [] = "_cxx_";
 
 	const Options& options () const noexcept
@@ -84,8 +88,11 @@ public:
 	static StateMembers get_members (const AST::ValueType& cont);
 
 	// Value and abstract bases of value base
-	typedef std::vector <const AST::IV_Base*> Bases;
-	static Bases get_all_bases (const AST::ValueType& vt);
+	typedef Analysis::Bases Bases;
+	static const Bases& get_all_bases (const AST::ValueType& vt);
+
+	// All interface bases, calculated once per interface
+	static const AST::Interfaces& get_all_bases (const AST::Interface& itf);
 
 	static const AST::Interface* get_concrete_supports (const AST::ValueType& vt);
 
@@ -147,14 +154,23 @@ public:
 
 	void init_union (Code& stm, const AST::UnionElement& init_el, const char* prefix = "");
 
-	static bool async_supported (const AST::Interface& itf) noexcept;
+	static bool async_supported (const AST::Interface& itf);
+
+	// Mark the section of the top-level definition in all the output files.
+	void section_begin (const AST::NamedItem& item);
+	void section_end ();
 
 protected:
-	CodeGenBase (const Compiler& compiler) :
-		BE::MessageOut (compiler.err_out ()),
+	CodeGenBase (const Compiler& compiler, std::ostream& err_out) :
+		BE::MessageOut (err_out),
 		compiler_ (compiler)
 	{}
 
+	// Register the output file of the generator.
+	// If self_contained is `true`, the file is split to the sections
+	// which do not share the namespace scopes.
+	void add_output (Code& code, bool self_contained = false);
+
 	virtual void leaf (const AST::Include& item) {}
 	virtual void leaf (const AST::Native&) {}
 	virtual void leaf (const AST::TypeDef& item) {}
@@ -191,31 +207,62 @@ protected:
 
 	static bool is_special_base (const AST::Interface& itf) noexcept;
 	static bool is_immutable (const AST::Interface& itf) noexcept;
-	static bool is_stateless (const AST::Interface& itf) noexcept;
+	static bool is_stateless (const AST::Interface& itf);
 
 	static bool is_custom (const AST::Operation& op) noexcept;
 	static bool is_custom (const AST::Interface& itf) noexcept;
-	static bool is_component (const AST::Interface& itf) noexcept;
+	static bool is_component (const AST::Interface& itf);
 
-	static std::string const_id (const AST::Constant& c);
+	static ScopedNameOf const_id (const AST::Constant& c)
+	{
+		return ScopedNameOf (c, '/');
+	}
 
 	static std::string skip_prefix (const AST::Identifier& id, const char* prefix);
 
 private:
-	static bool pred (const char* l, const char* r)
-	{
-		return strcmp (l, r) < 0;
-	}
-
 	static void get_all_bases (const AST::ValueType& vt,
 		std::unordered_set <const AST::IV_Base*>& bset, Bases& bvec);
 	static void get_all_bases (const AST::Interface& ai,
 		std::unordered_set <const AST::IV_Base*>& bset, Bases& bvec);
 
+	// Properties of the structured types are calculated once per type.
+	enum Property : unsigned
+	{
+		PROP_VAR_LEN = 1,
+		PROP_COMPLEX = 2,
+		PROP_MAY_BE_CDR = 4 // All members are fixed length CDR types
+	};
+
+	static bool property (const AST::StructBase& item, Property prop, bool (*calc) (const AST::StructBase&));
+	static bool may_be_CDR (const AST::Type& type);
+
+	typedef Analysis::InterfaceInfo InterfaceInfo;
+
+	static const InterfaceInfo& interface_info (const AST::Interface& itf);
+
+	// Returns the value from the current analysis table or calculates and stores it.
+	// The references remain valid until the analysis is cleared before the next file.
+	template <class K, class V, class F>
+	static const V& memoize (std::unordered_map <const K*, V> Analysis::* table, const K& key, F calc)
+	{
+		Analysis& analysis = Analysis::current ();
+		{
+			std::lock_guard <std::mutex> lock (analysis.mutex);
+			auto f = (analysis.*table).find (&key);
+			if (f != (analysis.*table).end ())
+				return f->second;
+		}
+		V value = calc (key);
+		std::lock_guard <std::mutex> lock (analysis.mutex);
+		return (analysis.*table).emplace (&key, std::move (value)).first->second;
+	}
+
 private:
 	static const char* const protected_names_ [];
 
 	const Compiler& compiler_;
+	std::vector <Code*> outputs_;
 };
 
 #endif
@@ -27,8 +27,20 @@
 #include "Client.h"
 #include "Servant.h"
 #include "Proxy.h"
+#include "Jobs.h"
+#include "Cache.h"
+#include "Dependencies.h"
+#include "Multiplexer.h"
+#include "Stats.h"
+#include "Watcher.h"
 #include <idlfe/AST/Builder.h>
+#include <algorithm>
+#include <fstream>
 #include <iostream>
+#include <iterator>
+#include <optional>
+#include <sstream>
+#include <thread>
 
 using std::filesystem::path;
 using namespace AST;
@@ -36,6 +48,14 @@ using namespace AST;
 const char Compiler::name_ [] = "Nirvana IDL to C++ compiler";
 const unsigned short Compiler::version_ [3] = { 0, 0, 1 };
 
+int Compiler::run (int argc, char* argv [])
+{
+	argc_ = argc;
+	argv_ = argv;
+	Analysis::Scope analysis (analysis_);
+	return main (argc, argv);
+}
+
 void Compiler::print_usage_info (const char* exe_name)
 {
 	std::cout << name_ << ".\n";
@@ -60,6 +80,31 @@ void Compiler::print_usage_info (const char* exe_name)
 		"\t-no_servant             Do not generate servant implementations.\n"
 		"\t-inc_cpp <file>         Add additional include file to each .cpp file\n"
 		"\t-no_ami                 Do not generate AMI\n"
+		"\t-j <N>                  Compile input files in N parallel threads.\n"
+		"\t-watch                  Recompile the files when they or their includes change.\n"
+		"\t-verbose                Print the name of each file compiled in the watch mode.\n"
+		"\t-client_shards          Write a client header per top-level definition.\n"
+		"\t                        The client header includes all of them.\n"
+		"\t-proxy_shards <N>       Split the proxy code into N files <name>_p[_<i>].cpp.\n"
+		"\t                        Each top-level definition is placed by the name hash.\n"
+		"\t-modules                Write C++20 module interface units <name>.cppm\n"
+		"\t                        exporting the generated headers.\n"
+		"\t                        The module name is the file path relative to the include\n"
+		"\t                        directory, with the dots as the delimiters.\n"
+		"\t-module_prefix <name>   Prefix for the module names.\n"
+		"\t-no_threads             Run the code generators sequentially.\n"
+		"\t-single_pass            Run all the code generators in one tree traversal.\n"
+		"\t-cache <directory>      Cache the generated files in the directory.\n"
+		"\t-reproducible           Generate output independent of the file locations.\n"
+		"\t-fingerprints           Write <file>.fp with the hash of each top-level definition.\n"
+		"\t-MD                     Write the dependency file <name>.d to the header directory.\n"
+		"\t-MF <file>              Write the dependency file to the specified path.\n"
+		"\t-manifest <file>        Write the list of the generated files.\n"
+		"\t-stats                  Print the compilation time and counters for each file.\n"
+		"\t-stats_json <file>      Append the statistics to the file as JSON lines.\n"
+		"\t@<file>                 Compile each line of the response file as a command line.\n"
+		"\t                        The other arguments are prepended to each line.\n"
+		"\t                        The lines are compiled in parallel with -j.\n"
 		"\t--version               Print compiler version\n";
 }
 
@@ -109,13 +154,465 @@ void Compiler::parse_arguments (CmdLine& args)
 
 	if (!no_ami)
 		includes ().emplace_back ("CORBA/AMI.idl");
+
+	if (!dep_file.empty () && files_.size () > 1)
+		throw std::invalid_argument ("-MF can not be used with multiple input files");
+
+	if (Role::DRIVER != role_) {
+		if (Role::ENTRY == role_ && !driver_args_.empty ())
+			throw std::invalid_argument (std::string (driver_args_.front ())
+				+ " can not be used in the response file");
+		return;
+	}
+
+	if (watch) {
+		if (files_.empty ())
+			throw std::invalid_argument ("-watch requires the input files");
+		watch_files ();
+	}
+
+	if (!batch_.empty ()) {
+		bool ok = build_batch ();
+		if (!ok || files_.empty ())
+			exit (ok ? EXIT_SUCCESS : EXIT_FAILURE);
+	}
+
+	if ((files_.size () > 1 && jobs > 1) || (!files_.empty () && !cache_dir.empty ()))
+		exit (build_parallel () ? EXIT_SUCCESS : EXIT_FAILURE);
+}
+
+Jobs::Arguments Compiler::common_args () const
+{
+	Jobs::Arguments args;
+	for (int i = 1; i < argc_; ++i) {
+		const char* arg = argv_ [i];
+		if (std::find (files_.begin (), files_.end (), arg) == files_.end ()
+			&& std::find (driver_args_.begin (), driver_args_.end (), arg) == driver_args_.end ())
+			args.emplace_back (arg);
+	}
+	return args;
+}
+
+bool Compiler::build_parallel ()
+{
+	// The files are compiled in this process by the worker compilers with the same command line.
+	// Each worker has its own front end state and AMI maps.
+	Jobs::Arguments common;
+	common.emplace_back (argv_ [0]);
+	{
+		Jobs::Arguments args = common_args ();
+		common.insert (common.end (), args.begin (), args.end ());
+	}
+
+	// The workers are already running in parallel
+	if (!no_threads && jobs > 1)
+		common.emplace_back ("-no_threads");
+
+	Paths generated;
+	std::vector <const char*> compile;
+	for (const char* file : files_) {
+		if (!restore_cached (file, generated))
+			compile.push_back (file);
+	}
+
+	// The single worker compiles all the files with one front end.
+	// Otherwise each file is a separate task.
+	std::vector <Jobs::Arguments> tasks;
+	for (const char* file : compile) {
+		if (tasks.empty () || jobs > 1)
+			tasks.push_back (common);
+		tasks.back ().emplace_back (file);
+	}
+
+	std::vector <Paths> outputs (tasks.size ());
+	bool ok = Jobs::run (tasks.size (), jobs, [&tasks, &outputs] (size_t i) {
+		return run_worker (tasks [i], outputs [i]) == 0;
+	});
+
+	for (const auto& o : outputs) {
+		generated.insert (generated.end (), o.begin (), o.end ());
+	}
+	add_to_manifest (generated);
+	return ok;
+}
+
+bool Compiler::restore_cached (const char* file, Paths& outputs)
+{
+	if (cache_dir.empty ())
+		return false;
+
+	std::string key = cache_key (file, dependencies (file));
+	Paths restored;
+	if (key.empty () || !Cache (cache_dir).restore (key, output_dirs (file), &restored))
+		return false;
+
+	if (make_deps)
+		write_dependencies (file, restored);
+	report_cached (file, restored);
+	outputs.insert (outputs.end (), restored.begin (), restored.end ());
+	return true;
+}
+
+int Compiler::run_worker (const Jobs::Arguments& args, Paths& outputs)
+{
+	std::vector <char*> argv = Jobs::argv (args);
+	Compiler worker (Role::WORKER);
+	int ret = worker.run ((int)args.size (), argv.data ());
+	outputs = std::move (worker.manifest_files_);
+	return ret;
+}
+
+bool Compiler::build_batch ()
+{
+	// The common arguments precede the arguments of each line
+	Jobs::Arguments common;
+	common.emplace_back (argv_ [0]);
+	{
+		Jobs::Arguments args = common_args ();
+		common.insert (common.end (), args.begin (), args.end ());
+	}
+
+	// The entries are already compiled in parallel
+	if (!no_threads && jobs > 1)
+		common.emplace_back ("-no_threads");
+
+	bool ok = true;
+	std::vector <Jobs::Arguments> entries;
+	for (const char* file : batch_) {
+		std::ifstream rsp (file);
+		if (!rsp) {
+			err_out () << "Can not open file " << file << std::endl;
+			ok = false;
+			continue;
+		}
+		std::string line;
+		while (std::getline (rsp, line)) {
+			Jobs::Arguments args = common;
+			if (!Jobs::split (line, args)) {
+				err_out () << "Missing closing quote: " << line << std::endl;
+				ok = false;
+			} else if (args.size () > common.size () && !args [common.size ()].starts_with ('#'))
+				entries.push_back (std::move (args));
+		}
+	}
+
+	std::vector <Paths> outputs (entries.size ());
+	if (!Jobs::run (entries.size (), jobs, [&entries, &outputs] (size_t i) {
+			return build_entry (entries [i], outputs [i]);
+		}))
+		ok = false;
+
+	for (const auto& o : outputs) {
+		add_to_manifest (o);
+	}
+	return ok;
+}
+
+bool Compiler::build_entry (const Jobs::Arguments& args, Paths& outputs)
+{
+	// The entry compiler parses the options and takes the input files
+	// from the front end, so nothing is compiled here.
+	std::vector <char*> argv = Jobs::argv (args);
+	Compiler entry (Role::ENTRY);
+	if (entry.run ((int)args.size (), argv.data ()) != 0)
+		return false;
+
+	// The cached files are removed from the command line.
+	// The input files point to the argv strings.
+	std::vector <const char*> cached;
+	for (const char* file : entry.files_) {
+		if (entry.restore_cached (file, outputs))
+			cached.push_back (file);
+	}
+	if (cached.size () == entry.files_.size ())
+		return true;
+
+	Jobs::Arguments compile;
+	for (size_t i = 0; i < args.size (); ++i) {
+		if (std::find (cached.begin (), cached.end (), argv [i]) == cached.end ())
+			compile.push_back (args [i]);
+	}
+	Paths generated;
+	bool ok = run_worker (compile, generated) == 0;
+	outputs.insert (outputs.end (), generated.begin (), generated.end ());
+	return ok;
+}
+
+path Compiler::manifest_fragment (size_t i) const
+{
+	path fragment = manifest;
+	fragment += '.' + std::to_string (i);
+	return fragment;
+}
+
+Compiler::Paths Compiler::read_manifest_fragment (const path& fragment)
+{
+	Paths outputs;
+	{
+		std::ifstream in (fragment);
+		std::string line;
+		while (std::getline (in, line)) {
+			if (!line.empty ())
+				outputs.emplace_back (line);
+		}
+	}
+	std::error_code ec;
+	std::filesystem::remove (fragment, ec);
+	return outputs;
+}
+
+void Compiler::watch_files ()
+{
+	// Each file is compiled by the child process with the same command line.
+	// The front end state can not be reused, but the fork is much cheaper
+	// than the process start.
+	Jobs::Arguments common;
+	common.emplace_back (argv_ [0]);
+	{
+		Jobs::Arguments args = common_args ();
+		common.insert (common.end (), args.begin (), args.end ());
+	}
+
+	std::vector <Paths> deps (files_.size ());
+	std::vector <Paths> outputs (files_.size ());
+	auto compile = [this, &common, &outputs] (size_t i) {
+		const char* file = files_ [i];
+		Jobs::Arguments args = common;
+		path fragment;
+		if (!manifest.empty ()) {
+			fragment = manifest_fragment (i);
+			args.emplace_back ("-manifest");
+			args.emplace_back (fragment.string ());
+		}
+		args.emplace_back (file);
+		if (verbose)
+			err_out () << "Compiling " << file << std::endl;
+		int ret = Jobs::execute (args, [] (int argc, char* argv []) {
+				return Compiler ().run (argc, argv);
+			});
+		if (ret != 0) {
+			// The previous outputs stay in the manifest
+			err_out () << "Compilation of " << file << " failed, exit code " << ret << std::endl;
+		} else if (!fragment.empty ())
+			outputs [i] = read_manifest_fragment (fragment);
+	};
+
+	// The file state is taken before the compilation,
+	// so the changes made during the compilation are not lost.
+	Watcher watcher;
+	auto snapshot = [&watcher, &deps] () {
+		Paths watched;
+		for (const auto& d : deps) {
+			watched.insert (watched.end (), d.begin (), d.end ());
+		}
+		watcher.snapshot (watched);
+	};
+
+	std::vector <size_t> affected;
+	for (size_t i = 0; i < files_.size (); ++i) {
+		affected.push_back (i);
+	}
+	for (;;) {
+		for (size_t i : affected) {
+			deps [i] = dependencies (files_ [i]).files ();
+		}
+		snapshot ();
+		for (size_t i : affected) {
+			compile (i);
+		}
+		manifest_files_.clear ();
+		for (const auto& o : outputs) {
+			add_to_manifest (o);
+		}
+
+		do {
+			const Paths changed = watcher.wait ();
+			affected.clear ();
+			for (size_t i = 0; i < files_.size (); ++i) {
+				if (std::find_first_of (deps [i].begin (), deps [i].end (),
+					changed.begin (), changed.end ()) != deps [i].end ())
+					affected.push_back (i);
+			}
+		} while (affected.empty ());
+	}
+}
+
+Dependencies Compiler::dependencies (const path& file)
+{
+	Dependencies deps (Dependencies::Paths (include_paths ().begin (), include_paths ().end ()));
+	deps.add_file (file);
+	path dir = file.parent_path ();
+	for (const auto& inc : includes ()) {
+		deps.add_include (inc, dir);
+	}
+	return deps;
+}
+
+void Compiler::write_make_name (std::ostream& out, const path& file)
+{
+	for (char c : file.generic_string ()) {
+		switch (c) {
+			case ' ':
+			case '#':
+				out << '\\';
+				break;
+			case '$':
+				out << '$';
+				break;
+		}
+		out << c;
+	}
+}
+
+void Compiler::write_dependencies (const path& file, const Paths& outputs)
+{
+	std::ostringstream out;
+	for (auto it = outputs.begin (); it != outputs.end (); ++it) {
+		if (it != outputs.begin ())
+			out << ' ';
+		write_make_name (out, *it);
+	}
+	out << ':';
+	for (const auto& dep : dependencies (file).files ()) {
+		out << " \\\n ";
+		write_make_name (out, dep);
+	}
+	out << '\n';
+	Code::write_if_changed (dep_file.empty () ? out_file (file, out_h, client_suffix, "d") : dep_file,
+		out.str ());
+}
+
+void Compiler::add_to_manifest (const Paths& outputs)
+{
+	manifest_files_.insert (manifest_files_.end (), outputs.begin (), outputs.end ());
+	if (manifest.empty ())
+		return;
+
+	std::string content;
+	for (const auto& f : manifest_files_) {
+		content += f.generic_string ();
+		content += '\n';
+	}
+	Code::write_if_changed (manifest, content);
+}
+
+std::string Compiler::cache_key (const path& file, const Dependencies& deps)
+{
+	if (!deps.complete ())
+		return std::string ();
+
+	// The key consists of the things affecting the generated content only.
+	// So the output locations, the reports and the include directories
+	// do not prevent the cache hits.
+	// The strings are prefixed with the length to separate them.
+	std::string key;
+	auto append = [&key] (std::string_view s) {
+		key += std::to_string (s.size ());
+		key += ':';
+		key += s;
+	};
+
+	// The version is stored as text, so the key does not depend on the host byte order.
+	for (unsigned short v : version_) {
+		append (std::to_string (v));
+	}
+
+	// The front end switches, like the macro definitions, except for the include directories.
+	// The resolved include files are added below.
+	for (int i = 1; i < argc_; ++i) {
+		const char* arg = argv_ [i];
+		if (std::find (files_.begin (), files_.end (), arg) != files_.end ()
+			|| std::find (driver_args_.begin (), driver_args_.end (), arg) != driver_args_.end ()
+			|| std::find (own_args_.begin (), own_args_.end (), arg) != own_args_.end ())
+			continue;
+		std::string_view a (arg);
+		if (a == "-I")
+			++i;
+		else if (!a.starts_with ("-I"))
+			append (a);
+	}
+
+	// The compiler options affecting the content.
+	// The new options must be added here.
+	append (client_suffix);
+	append (servant_suffix);
+	append (proxy_suffix);
+	append (inc_cpp);
+	append (module_prefix);
+	const bool flags [] = { client, server, proxy, legacy, no_servant, no_client_cpp, no_ami,
+		reproducible, fingerprints, client_shards, modules };
+	for (bool f : flags) {
+		key += f ? '1' : '0';
+	}
+	append (std::to_string (proxy_shards));
+
+	// The output file names and the relative locations of the output directories
+	// are used in the include directives.
+	append (file.filename ().string ());
+	const Cache::Dirs dirs = output_dirs (file);
+	auto dir_path = [] (const path& dir) {
+		return dir.empty () ? path (".") : dir;
+	};
+	const path h_dir = dir_path (dirs.at ("h"));
+	for (const auto& dir : dirs) {
+		append (dir.first);
+		append (std::filesystem::relative (dir_path (dir.second), h_dir).generic_string ());
+	}
+
+	// Unless -reproducible, the header guards depend on the header directory.
+	if (!reproducible)
+		append (std::filesystem::weakly_canonical (h_dir).generic_string ());
+
+	if (modules) {
+		const OutputFiles files = output_files (file);
+		if (client)
+			append (module_name (file, files.client_module));
+		if (server)
+			append (module_name (file, files.servant_module));
+	}
+
+	for (const auto& dep : deps.files ()) {
+		std::ifstream f (dep, std::ios::binary);
+		append (std::string (std::istreambuf_iterator <char> (f), std::istreambuf_iterator <char> ()));
+	}
+
+	return key;
+}
+
+Cache::Dirs Compiler::output_dirs (const path& idl) const
+{
+	const path dir = idl.parent_path ();
+	return {
+		{ "h", out_h.empty () ? dir : out_h },
+		{ "cpp", out_cpp.empty () ? dir : out_cpp },
+		{ "proxy", out_proxy.empty () ? dir : out_proxy }
+	};
 }
 
 bool Compiler::parse_command_line (CmdLine& args)
 {
+	if ('@' == *args.arg ()) {
+		// Response file
+		driver_args_.push_back (args.arg ());
+		batch_.push_back (args.arg () + 1);
+		args.next ();
+		return true;
+	}
+
+	if ('-' != *args.arg ()) {
+		// Input file
+		files_.push_back (args.arg ());
+		if (Role::ENTRY == role_) {
+			args.next ();
+			return true;
+		}
+		return IDL_FrontEnd::parse_command_line (args);
+	}
+
 	if (IDL_FrontEnd::parse_command_line (args))
 		return true;
 
+	const char* own_arg = args.arg ();
 	const char* arg = nullptr;
 	if ((arg = option (args.arg (), "out_h")))
 		out_h = args.parameter (arg);
@@ -165,55 +662,396 @@ bool Compiler::parse_command_line (CmdLine& args)
 		std::cout << std::endl;
 	} else if ((arg = option (args.arg (), "out_proxy")))
 		out_proxy = args.parameter (arg);
+	else if ((arg = option (args.arg (), "no_threads")))
+		no_threads = true;
+	else if ((arg = option (args.arg (), "single_pass")))
+		single_pass = true;
+	else if ((arg = option (args.arg (), "cache")))
+		cache_dir = args.parameter (arg);
+	else if ((arg = option (args.arg (), "stats_json")))
+		stats_json = args.parameter (arg);
+	else if ((arg = option (args.arg (), "stats")))
+		stats = true;
+	else if ((arg = option (args.arg (), "reproducible")))
+		reproducible = true;
+	else if ((arg = option (args.arg (), "fingerprints")))
+		fingerprints = true;
+	else if ((arg = option (args.arg (), "client_shards")))
+		client_shards = true;
+	else if ((arg = option (args.arg (), "modules")))
+		modules = true;
+	else if ((arg = option (args.arg (), "module_prefix")))
+		module_prefix = args.parameter (arg);
+	else if ((arg = option (args.arg (), "proxy_shards"))) {
+		const char* n = args.parameter (arg);
+		int cnt = atoi (n);
+		if (cnt <= 0)
+			throw std::invalid_argument (std::string ("Invalid number of proxy shards: ") + n);
+		proxy_shards = cnt;
+	}
+	else if ((arg = option (args.arg (), "MD")))
+		make_deps = true;
+	else if ((arg = option (args.arg (), "MF"))) {
+		dep_file = args.parameter (arg);
+		make_deps = true;
+	} else if ((arg = option (args.arg (), "manifest"))) {
+		// The driver process writes the manifest for all files
+		driver_args_.push_back (args.arg ());
+		const char* file = args.parameter (arg);
+		driver_args_.push_back (file);
+		manifest = file;
+	}
+	else if ((arg = option (args.arg (), "watch"))) {
+		driver_args_.push_back (args.arg ());
+		watch = true;
+	} else if ((arg = option (args.arg (), "verbose"))) {
+		driver_args_.push_back (args.arg ());
+		verbose = true;
+	} else if ((arg = option (args.arg (), "j"))) {
+		driver_args_.push_back (args.arg ());
+		const char* n = args.parameter (arg);
+		driver_args_.push_back (n);
+		int cnt = atoi (n);
+		if (cnt <= 0)
+			throw std::invalid_argument (std::string ("Invalid number of jobs: ") + n);
+		jobs = cnt;
+	}
 
 	if (arg) {
+		// The option and its parameter
+		own_args_.push_back (own_arg);
+		own_args_.push_back (args.arg ());
 		args.next ();
 		return true;
 	} else
 		return false;
 }
 
-path Compiler::out_file (const Root& tree, const path& dir, const std::string& suffix, const char* ext) const
+path Compiler::out_file (const path& idl, const path& dir, const std::string& suffix, const char* ext) const
 {
-	path name (tree.file ().stem ().string () + suffix);
+	path name (idl.stem ().string () + suffix);
 	name.replace_extension (ext);
 	if (!dir.empty ())
 		return dir / name;
 	else
-		return tree.file ().parent_path () / name;
+		return idl.parent_path () / name;
 }
 
-void Compiler::generate_code (const Root& tree)
+Compiler::OutputFiles Compiler::output_files (const path& idl) const
 {
-	path client_h = out_file (tree, out_h, client_suffix, "h");
+	OutputFiles files;
+	files.client_h = out_file (idl, out_h, client_suffix, "h");
 	if (client) {
-		path client_cpp;
-		if (!no_client_cpp)
-			client_cpp = out_file (tree, out_cpp, client_suffix, "cpp");
-		Client client (*this, tree, client_h, client_cpp);
-		tree.visit (client);
-	}
-	path servant_h = out_file (tree, out_h, servant_suffix, "h");
-	if (server) {
-		Servant servant (*this, tree, servant_h, client_h);
-		tree.visit (servant);
+		files.generated.push_back (files.client_h);
+		if (!no_client_cpp) {
+			files.client_cpp = out_file (idl, out_cpp, client_suffix, "cpp");
+			files.generated.push_back (files.client_cpp);
+		}
 	}
+	files.servant_h = out_file (idl, out_h, servant_suffix, "h");
+	if (server)
+		files.generated.push_back (files.servant_h);
 	if (proxy) {
-		Proxy proxy (*this, tree, out_file (tree, out_proxy, proxy_suffix, "cpp"), servant_h);
-		tree.visit (proxy);
+		files.proxy_cpp = out_file (idl, out_proxy, proxy_suffix, "cpp");
+		files.generated.push_back (files.proxy_cpp);
+	}
+	if (fingerprints) {
+		for (size_t i = 0, cnt = files.generated.size (); i < cnt; ++i) {
+			files.generated.push_back (Code::fingerprint_file (files.generated [i]));
+		}
+	}
+	if (proxy && proxy_shards > 1) {
+		// The fingerprints of all the definitions are in the main file .fp
+		const Paths shards = proxy_shard_files (files.proxy_cpp);
+		files.generated.insert (files.generated.end (), shards.begin () + 1, shards.end ());
+	}
+	if (modules) {
+		if (client) {
+			files.client_module = out_file (idl, out_h, client_suffix, "cppm");
+			files.generated.push_back (files.client_module);
+		}
+		if (server) {
+			files.servant_module = out_file (idl, out_h, servant_suffix, "cppm");
+			files.generated.push_back (files.servant_module);
+		}
+	}
+	return files;
+}
+
+std::vector <path> Compiler::proxy_shard_files (const path& proxy_cpp) const
+{
+	std::vector <path> files;
+	files.reserve (proxy_shards);
+	files.push_back (proxy_cpp);
+	const std::string stem = proxy_cpp.stem ().string ();
+	for (unsigned i = 1; i < proxy_shards; ++i) {
+		path name (stem + '_' + std::to_string (i));
+		name += proxy_cpp.extension ();
+		files.push_back (proxy_cpp.parent_path () / name);
+	}
+	return files;
+}
+
+std::string Compiler::module_name (const path& idl, const path& file)
+{
+	// The name consists of the module prefix, the IDL file directory relative to the
+	// include directory containing it, and the module file name.
+	// So the files with the same name in the different directories give the different modules.
+	// The characters not allowed in identifiers are replaced.
+	std::optional <path> rel_idl;
+	const path abs_idl = std::filesystem::absolute (idl).lexically_normal ();
+	for (const auto& inc : include_paths ()) {
+		path rel = abs_idl.lexically_relative (std::filesystem::absolute (path (inc)).lexically_normal ());
+		if (rel.empty () || *rel.begin () == "..")
+			continue;
+		if (!rel_idl || rel.native ().size () < rel_idl->native ().size ())
+			rel_idl = std::move (rel);
+	}
+
+	// The components which are the C++ keywords, module, import or the reserved std<N>
+	// are protected like the identifiers.
+	std::string name = module_prefix;
+	auto append = [&name] (const std::string& part) {
+		if (!name.empty ())
+			name += '.';
+		const size_t begin = name.size ();
+		name += part;
+		for (size_t i = begin; i < name.size (); ++i) {
+			if (!isalnum ((unsigned char)name [i]) && name [i] != '_')
+				name [i] = '_';
+		}
+		const std::string_view id = std::string_view (name).substr (begin);
+		if (isdigit ((unsigned char)name [begin]))
+			name.insert (begin, 1, '_');
+		else if (CodeGenBase::is_keyword (id) || id == "module" || id == "import"
+			|| (id.starts_with ("std") && std::all_of (id.begin () + 3, id.end (),
+				[] (char c) { return isdigit ((unsigned char)c); })))
+			name.insert (begin, CodeGenBase::protected_prefix_);
+	};
+	if (rel_idl) {
+		for (const auto& dir : rel_idl->parent_path ()) {
+			append (dir.string ());
+		}
+	}
+	append (file.stem ().string ());
+	return name;
+}
+
+void Compiler::write_module (const path& file, const path& header, const Root& tree)
+{
+	const std::string name = module_name (tree.file (), file);
+
+	// The header is imported as the header unit.
+	// Unlike the exported using-declarations, the header unit makes all the template
+	// specializations and the internal linkage constants available to the importers.
+	Code code (file, tree);
+	code << "export module " << name << ";\n"
+		"\n"
+		"export import \"" << std::filesystem::relative (header, file.parent_path ()).generic_string ()
+		<< "\";\n";
+	code.close ();
+}
+
+// The top-level definition sections are marked by Multiplexer.
+void Compiler::visit (const Root& tree, CodeGenBase& cg) const
+{
+	if (fingerprints || client_shards || proxy_shards > 1) {
+		Multiplexer mux;
+		mux.add (cg);
+		tree.visit (mux);
+	} else
+		tree.visit (cg);
+}
+
+void Compiler::generate_code (const Root& tree)
+{
+	stats_.front_end = Stats::seconds (phase_begin_) - stats_.ami;
+
+	const OutputFiles files = output_files (tree.file ());
+	std::vector <Generator> generators;
+	std::vector <const char*> names;
+
+	if (single_pass && (client + server + proxy) > 1) {
+		// All the generators are driven by the single tree traversal
+		names.push_back ("All");
+		generators.push_back ([this, &tree, &files] (std::ostream& err) {
+			std::optional <Client> client_gen;
+			std::optional <Servant> servant_gen;
+			std::optional <Proxy> proxy_gen;
+			Multiplexer all;
+			if (client)
+				all.add (client_gen.emplace (*this, err, tree, files.client_h, files.client_cpp));
+			if (server)
+				all.add (servant_gen.emplace (*this, err, tree, files.servant_h, files.client_h));
+			if (proxy)
+				all.add (proxy_gen.emplace (*this, err, tree, files.proxy_cpp, files.servant_h));
+			tree.visit (all);
+		});
+	} else {
+		if (client) {
+			names.push_back ("Client");
+			generators.push_back ([this, &tree, &files] (std::ostream& err) {
+				Client client (*this, err, tree, files.client_h, files.client_cpp);
+				visit (tree, client);
+			});
+		}
+		if (server) {
+			names.push_back ("Servant");
+			generators.push_back ([this, &tree, &files] (std::ostream& err) {
+				Servant servant (*this, err, tree, files.servant_h, files.client_h);
+				visit (tree, servant);
+			});
+		}
+		if (proxy) {
+			names.push_back ("Proxy");
+			generators.push_back ([this, &tree, &files] (std::ostream& err) {
+				Proxy proxy (*this, err, tree, files.proxy_cpp, files.servant_h);
+				visit (tree, proxy);
+			});
+		}
+	}
+
+	std::vector <double> times;
+	run_generators (generators, times);
+
+	if (!files.client_module.empty ())
+		write_module (files.client_module, files.client_h, tree);
+	if (!files.servant_module.empty ())
+		write_module (files.servant_module, files.servant_h, tree);
+
+	Paths generated = files.generated;
+	generated.insert (generated.end (), generated_.begin (), generated_.end ());
+
+	if (!cache_key_.empty ())
+		Cache (cache_dir).store (cache_key_, output_dirs (tree.file ()), generated);
+	if (make_deps)
+		write_dependencies (tree.file (), generated);
+	add_to_manifest (generated);
+
+	if (stats || !stats_json.empty ()) {
+		stats_.ami_objects = (unsigned)(ami_pollers_.size () + ami_handlers_.size ());
+		for (size_t i = 0; i < names.size (); ++i) {
+			stats_.generators.emplace_back (names [i], times [i]);
+		}
+		stats_.add_outputs (generated);
+		report_stats ();
+	}
+}
+
+void Compiler::report_cached (const path& file, const Paths& outputs)
+{
+	if (stats || !stats_json.empty ()) {
+		stats_ = Stats ();
+		stats_.file = file;
+		stats_.cached = true;
+		stats_.add_outputs (outputs);
+		report_stats ();
+	}
+}
+
+void Compiler::report_stats ()
+{
+	if (stats)
+		stats_.print (std::cout);
+	if (!stats_json.empty ()) {
+		// Build the line first to append it with a single write,
+		// the parallel processes may share the file.
+		std::ostringstream line;
+		stats_.print_json (line);
+		std::ofstream out (stats_json, std::ios::app);
+		out << line.str () << std::flush;
+		if (!out)
+			throw std::runtime_error ("Error writing file " + stats_json.string ());
+	}
+}
+
+void Compiler::run_generators (const std::vector <Generator>& generators, std::vector <double>& times)
+{
+	// The generators only read the AST and write to the different files,
+	// so they can run concurrently.
+	// Each generator has own message buffer, messages are output in the generator order.
+	struct Result
+	{
+		std::ostringstream err;
+		std::exception_ptr exception;
+		double time = 0;
+	};
+
+	std::vector <Result> results (generators.size ());
+	auto run = [this, &generators, &results] (size_t i) {
+		Analysis::Scope analysis (analysis_);
+		Stats::Clock::time_point begin = Stats::Clock::now ();
+		try {
+			generators [i] (results [i].err);
+		} catch (...) {
+			results [i].exception = std::current_exception ();
+		}
+		results [i].time = Stats::seconds (begin);
+	};
+
+	if (no_threads || generators.size () < 2) {
+		for (size_t i = 0; i < generators.size (); ++i) {
+			run (i);
+			if (results [i].exception)
+				break;
+		}
+	} else {
+		std::vector <std::thread> threads;
+		threads.reserve (generators.size () - 1);
+		for (size_t i = 1; i < generators.size (); ++i) {
+			threads.emplace_back (run, i);
+		}
+		run (0);
+		for (auto& t : threads) {
+			t.join ();
+		}
+	}
+
+	times.clear ();
+	for (const auto& res : results) {
+		err_out () << res.err.str ();
+		times.push_back (res.time);
+	}
+	for (const auto& res : results) {
+		if (res.exception)
+			std::rethrow_exception (res.exception);
 	}
 }
 
 void Compiler::file_begin (const std::filesystem::path& file, Builder& builder)
 {
+	// The timer is reset here, so the file that failed in the front end
+	// does not add its time to the next file.
+	phase_begin_ = Stats::Clock::now ();
+	stats_ = Stats ();
+	stats_.file = file;
+	main_file_ = file;
+	analysis_.clear ();
 	ami_interfaces_.clear ();
 	ami_handlers_.clear ();
 	ami_pollers_.clear ();
+	// The outputs of the file failed in the generation must not go to the next file
+	generated_.clear ();
+	cache_key_.clear ();
+	if (!cache_dir.empty ())
+		cache_key_ = cache_key (file, dependencies (file));
 }
 
 void Compiler::interface_end (const Interface& itf, Builder& builder)
 {
+	++stats_.interfaces;
+	for (auto item : itf) {
+		if (item->kind () == Item::Kind::OPERATION)
+			++stats_.operations;
+	}
+
 	if (async_supported (itf)) {
+		Stats::Clock::time_point ami_begin = Stats::Clock::now ();
+
+		// The code is generated only for the interfaces from the main file.
+		// The included interfaces get the Poller and Handler without operations,
+		// they are only needed as the bases of the main file AMI types.
+		const bool shell = !is_main_file (itf);
 
 		Location loc = builder.location ();
 		SimpleDeclarator ami_return_val (AMI_RETURN_VAL, loc);
@@ -240,41 +1078,43 @@ void Compiler::interface_end (const Interface& itf, Builder& builder)
 				bases.push_front (ScopedName (loc, true, { "Messaging", "Poller" }));
 			builder.valuetype_bases (false, bases);
 
-			for (auto item : itf) {
-				switch (item->kind ()) {
-				case Item::Kind::OPERATION: {
-					const Operation& op = static_cast <const Operation&> (*item);
-					builder.operation_begin (false, Type (), SimpleDeclarator (op.name (), loc));
+			if (!shell) {
+				for (auto item : itf) {
+					switch (item->kind ()) {
+					case Item::Kind::OPERATION: {
+						const Operation& op = static_cast <const Operation&> (*item);
+						builder.operation_begin (false, Type (), SimpleDeclarator (op.name (), loc));
 
-					builder.parameter (Parameter::Attribute::IN, Type (BasicType::ULONG), ami_timeout);
-					if (op.tkind () != Type::Kind::VOID)
-						builder.parameter (Parameter::Attribute::OUT, Type (op), ami_return_val);
-
-					for (auto par : op) {
-						if (par->attribute () != Parameter::Attribute::IN)
-							builder.parameter (Parameter::Attribute::OUT, Type (*par), SimpleDeclarator (par->name (), loc));
-					}
+						builder.parameter (Parameter::Attribute::IN, Type (BasicType::ULONG), ami_timeout);
+						if (op.tkind () != Type::Kind::VOID)
+							builder.parameter (Parameter::Attribute::OUT, Type (op), ami_return_val);
 
-					builder.raises (poller_raises (loc, op.raises ()));
-					builder.operation_end ();
-				} break;
+						for (auto par : op) {
+							if (par->attribute () != Parameter::Attribute::IN)
+								builder.parameter (Parameter::Attribute::OUT, Type (*par), SimpleDeclarator (par->name (), loc));
+						}
 
-				case Item::Kind::ATTRIBUTE: {
-					const Attribute& att = static_cast <const Attribute&> (*item);
+						builder.raises (poller_raises (loc, op.raises ()));
+						builder.operation_end ();
+					} break;
 
-					builder.operation_begin (false, Type (), SimpleDeclarator ("get_" + att.name (), loc));
-					builder.parameter (Parameter::Attribute::IN, Type (BasicType::ULONG), ami_timeout);
-					builder.parameter (Parameter::Attribute::OUT, Type (att), ami_return_val);
-					builder.raises (poller_raises (loc, att.getraises ()));
-					builder.operation_end ();
+					case Item::Kind::ATTRIBUTE: {
+						const Attribute& att = static_cast <const Attribute&> (*item);
 
-					if (!att.readonly ()) {
-						builder.operation_begin (false, Type (), SimpleDeclarator ("set_" + att.name (), loc));
+						builder.operation_begin (false, Type (), SimpleDeclarator ("get_" + att.name (), loc));
 						builder.parameter (Parameter::Attribute::IN, Type (BasicType::ULONG), ami_timeout);
-						builder.raises (poller_raises (loc, att.setraises ()));
+						builder.parameter (Parameter::Attribute::OUT, Type (att), ami_return_val);
+						builder.raises (poller_raises (loc, att.getraises ()));
 						builder.operation_end ();
+
+						if (!att.readonly ()) {
+							builder.operation_begin (false, Type (), SimpleDeclarator ("set_" + att.name (), loc));
+							builder.parameter (Parameter::Attribute::IN, Type (BasicType::ULONG), ami_timeout);
+							builder.raises (poller_raises (loc, att.setraises ()));
+							builder.operation_end ();
+						}
+					} break;
 					}
-				} break;
 				}
 			}
 
@@ -297,49 +1137,51 @@ void Compiler::interface_end (const Interface& itf, Builder& builder)
 				bases.push_front (ScopedName (loc, true, { "Messaging", "ReplyHandler" }));
 			builder.interface_bases (bases);
 
-			for (auto item : itf) {
-				switch (item->kind ()) {
-				case Item::Kind::OPERATION: {
-					const Operation& op = static_cast <const Operation&> (*item);
+			if (!shell) {
+				for (auto item : itf) {
+					switch (item->kind ()) {
+					case Item::Kind::OPERATION: {
+						const Operation& op = static_cast <const Operation&> (*item);
 
-					builder.operation_begin (false, Type (), SimpleDeclarator (op.name (), loc));
+						builder.operation_begin (false, Type (), SimpleDeclarator (op.name (), loc));
 
-					if (op.tkind () != Type::Kind::VOID)
-						builder.parameter (Parameter::Attribute::IN, Type (op), ami_return_val);
+						if (op.tkind () != Type::Kind::VOID)
+							builder.parameter (Parameter::Attribute::IN, Type (op), ami_return_val);
 
-					for (auto par : op) {
-						if (par->attribute () != Parameter::Attribute::IN)
-							builder.parameter (Parameter::Attribute::IN, Type (*par), SimpleDeclarator (par->name (), loc));
-					}
-
-					builder.operation_end ();
+						for (auto par : op) {
+							if (par->attribute () != Parameter::Attribute::IN)
+								builder.parameter (Parameter::Attribute::IN, Type (*par), SimpleDeclarator (par->name (), loc));
+						}
 
-					builder.operation_begin (false, Type (), SimpleDeclarator (op.name () + AMI_EXCEP, loc));
-					builder.parameter (Parameter::Attribute::IN, Type (exception_holder), excep_holder);
-					builder.operation_end ();
-
-				} break;
+						builder.operation_end ();
 
-				case Item::Kind::ATTRIBUTE: {
-					const Attribute& att = static_cast <const Attribute&> (*item);
+						builder.operation_begin (false, Type (), SimpleDeclarator (op.name () + AMI_EXCEP, loc));
+						builder.parameter (Parameter::Attribute::IN, Type (exception_holder), excep_holder);
+						builder.operation_end ();
 
-					builder.operation_begin (false, Type (), SimpleDeclarator ("get_" + att.name (), loc));
-					builder.parameter (Parameter::Attribute::IN, Type (att), ami_return_val);
-					builder.operation_end ();
+					} break;
 
-					builder.operation_begin (false, Type (), SimpleDeclarator ("get_" + att.name () + AMI_EXCEP, loc));
-					builder.parameter (Parameter::Attribute::IN, Type (exception_holder), excep_holder);
-					builder.operation_end ();
+					case Item::Kind::ATTRIBUTE: {
+						const Attribute& att = static_cast <const Attribute&> (*item);
 
-					if (!att.readonly ()) {
-						builder.operation_begin (false, Type (), SimpleDeclarator ("set_" + att.name (), loc));
+						builder.operation_begin (false, Type (), SimpleDeclarator ("get_" + att.name (), loc));
+						builder.parameter (Parameter::Attribute::IN, Type (att), ami_return_val);
 						builder.operation_end ();
 
-						builder.operation_begin (false, Type (), SimpleDeclarator ("set_" + att.name () + AMI_EXCEP, loc));
+						builder.operation_begin (false, Type (), SimpleDeclarator ("get_" + att.name () + AMI_EXCEP, loc));
 						builder.parameter (Parameter::Attribute::IN, Type (exception_holder), excep_holder);
 						builder.operation_end ();
+
+						if (!att.readonly ()) {
+							builder.operation_begin (false, Type (), SimpleDeclarator ("set_" + att.name (), loc));
+							builder.operation_end ();
+
+							builder.operation_begin (false, Type (), SimpleDeclarator ("set_" + att.name () + AMI_EXCEP, loc));
+							builder.parameter (Parameter::Attribute::IN, Type (exception_holder), excep_holder);
+							builder.operation_end ();
+						}
+					} break;
 					}
-				} break;
 				}
 			}
 
@@ -350,9 +1192,19 @@ void Compiler::interface_end (const Interface& itf, Builder& builder)
 		ami_interfaces_.emplace (&itf, ami_objects);
 		ami_handlers_.emplace (ami_objects.handler, &itf);
 		ami_pollers_.insert (ami_objects.poller);
+
+		stats_.ami += Stats::seconds (ami_begin);
 	}
 }
 
+bool Compiler::is_main_file (const NamedItem& item) const
+{
+	if (item.file () == main_file_)
+		return true;
+	std::error_code ec;
+	return std::filesystem::equivalent (item.file (), main_file_, ec);
+}
+
 bool Compiler::async_supported (const Interface& itf) const
 {
 	return !no_ami && CodeGenBase::async_supported (itf);
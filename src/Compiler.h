@@ -28,14 +28,22 @@
 #pragma once
 
 #include <unordered_map>
+#include <functional>
+#include <mutex>
 
 #include "Options.h"
+#include "Analysis.h"
+#include "Dependencies.h"
+#include "Cache.h"
+#include "Stats.h"
 
 #include <idlfe/IDL_FrontEnd.h>
 #include <idlfe/AST/Interface.h>
 #include <idlfe/AST/Exception.h>
 #include <idlfe/AST/ValueType.h>
 
+class CodeGenBase;
+
 class Compiler :
 	public IDL_FrontEnd,
 	public Options
@@ -44,15 +52,35 @@ public:
 	static const char name_ [];
 	static const unsigned short version_ [3];
 
-	Compiler () :
-		IDL_FrontEnd (IDL_FrontEnd::FLAG_ENABLE_CONST_OBJREF)
+	enum class Role
+	{
+		DRIVER,
+		WORKER, // Compiles a part of the driver input files
+		ENTRY   // Parses the response file entry for the driver, does not compile
+	};
+
+	explicit Compiler (Role role = Role::DRIVER) :
+		IDL_FrontEnd (IDL_FrontEnd::FLAG_ENABLE_CONST_OBJREF),
+		argc_ (0),
+		argv_ (nullptr),
+		role_ (role)
 	{}
 
+	int run (int argc, char* argv []);
+
 	std::ostream& err_out () const noexcept
 	{
 		return IDL_FrontEnd::err_out ();
 	}
 
+	// Add the output file which is known only after the generation.
+	// Called by the generators, possibly concurrently.
+	void add_generated (const std::filesystem::path& file) const
+	{
+		std::lock_guard <std::mutex> lock (generated_mutex_);
+		generated_.push_back (file);
+	}
+
 	struct AMI_Objects
 	{
 		const AST::ValueType* poller;
@@ -84,6 +112,9 @@ public:
 		return ami_pollers_;
 	}
 
+	// The proxy source files, the first is the proxy_cpp itself.
+	std::vector <std::filesystem::path> proxy_shard_files (const std::filesystem::path& proxy_cpp) const;
+
 private:
 	// Override print_usage_info for additional usage information.
 	virtual void print_usage_info (const char* exe_name) override;
@@ -104,14 +135,114 @@ private:
 	AST::Identifier make_ami_id (const AST::Interface& itf, const char* suffix);
 
 	bool async_supported (const AST::Interface& itf) const;
+	bool is_main_file (const AST::NamedItem& item) const;
 
 	static AST::ScopedNames poller_raises (const AST::Location& loc, const AST::Raises& op_raises);
 
-	std::filesystem::path out_file (const AST::Root& tree, const std::filesystem::path& dir,
+	std::filesystem::path out_file (const std::filesystem::path& idl, const std::filesystem::path& dir,
 		const std::string& suffix, const char* ext) const;
 
+	typedef std::vector <std::filesystem::path> Paths;
+
+	struct OutputFiles
+	{
+		std::filesystem::path client_h, client_cpp, servant_h, proxy_cpp;
+		std::filesystem::path client_module, servant_module;
+
+		// Files to generate
+		Paths generated;
+	};
+
+	OutputFiles output_files (const std::filesystem::path& idl) const;
+
+	// Write C++20 module interface unit exporting the header unit.
+	void write_module (const std::filesystem::path& file, const std::filesystem::path& header,
+		const AST::Root& tree);
+
+	// Module name for the module interface unit file generated from the IDL file.
+	std::string module_name (const std::filesystem::path& idl, const std::filesystem::path& file);
+
+	Dependencies dependencies (const std::filesystem::path& file);
+	void write_dependencies (const std::filesystem::path& file, const Paths& outputs);
+	static void write_make_name (std::ostream& out, const std::filesystem::path& file);
+	void add_to_manifest (const Paths& outputs);
+
+	bool build_parallel ();
+
+	// Restore the outputs of the file from the cache.
+	// Returns `false` if the file must be compiled.
+	bool restore_cached (const char* file, Paths& outputs);
+
+	// Run the worker compiler with the command line.
+	// Returns the exit code, outputs receive the generated files.
+	static int run_worker (const std::vector <std::string>& args, Paths& outputs);
+
+	// The worker process writes the list of its outputs to the manifest fragment,
+	// the sharded outputs are known only after the generation.
+	std::filesystem::path manifest_fragment (size_t i) const;
+	static Paths read_manifest_fragment (const std::filesystem::path& fragment);
+
+	// Compile each line of the response files as the command line.
+	// Returns `false` if any of the lines failed.
+	bool build_batch ();
+
+	// Compile the response file entry by its own compilers, so the entry options
+	// do not affect the other entries.
+	static bool build_entry (const std::vector <std::string>& args, Paths& outputs);
+
+	// Compile the files and recompile them on each change in the include closure.
+	// Never returns.
+	void watch_files ();
+
+	// Command line arguments except for the input files and the driver switches.
+	std::vector <std::string> common_args () const;
+
+	// Generation cache key for the file, empty if the file can not be cached.
+	std::string cache_key (const std::filesystem::path& file, const Dependencies& deps);
+
+	// The output directories by role for the cache.
+	Cache::Dirs output_dirs (const std::filesystem::path& idl) const;
+
+	// Code generator task. Receives the stream for the error messages.
+	typedef std::function <void (std::ostream&)> Generator;
+
+	void run_generators (const std::vector <Generator>& generators, std::vector <double>& times);
+	void visit (const AST::Root& tree, CodeGenBase& cg) const;
+	void report_stats ();
+	void report_cached (const std::filesystem::path& file, const Paths& outputs);
+
 private:
+	int argc_;
+	char** argv_;
+	const Role role_;
+
+	// Input files and the switches which are not passed to the workers.
+	// Both point to the argv_ strings.
+	std::vector <const char*> files_;
+	std::vector <const char*> driver_args_;
+
+	// Switches parsed by the compiler itself, point to the argv_ strings.
+	// The rest are the front end switches.
+	std::vector <const char*> own_args_;
+
+	// Response files, point to the argv_ strings after '@'.
+	std::vector <const char*> batch_;
+
+	std::string cache_key_;
+	Paths manifest_files_;
+
+	// Outputs added by the generators
+	mutable std::mutex generated_mutex_;
+	mutable Paths generated_;
+
+	Stats stats_;
+	Stats::Clock::time_point phase_begin_;
+
+	// Memoized AST properties of the current file
+	Analysis analysis_;
+
 	AMI_Interfaces ami_interfaces_;
+	std::filesystem::path main_file_;
 	AMI_Handlers ami_handlers_;
 	AMI_Pollers ami_pollers_;
 };
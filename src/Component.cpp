@@ -265,7 +265,7 @@ Servant::ComponentFlags Servant::define_component (const Interface& itf, Operati
 
 		// Collect ports from all bases
 		{
-			Interfaces bases = itf.get_all_bases ();
+			const Interfaces& bases = get_all_bases (itf);
 			for (const auto b : bases) {
 				size_t sz_fac = ports.facets.size ();
 				size_t sz_rec = ports.receptacles.size ();
@@ -0,0 +1,119 @@
+/*
+* Nirvana IDL to C++ compiler.
+*
+* This is a part of the Nirvana project.
+*
+* Author: Igor Popov
+*
+* Copyright (c) 2021 Igor Popov.
+*
+* This program is free software; you can redistribute it and/or modify
+* it under the terms of the GNU Lesser General Public License as published by
+* the Free Software Foundation; either version 3 of the License, or
+* (at your option) any later version.
+*
+* This program is distributed in the hope that it will be useful,
+* but WITHOUT ANY WARRANTY; without even the implied warranty of
+* MERCHANTABILITY or FITNESS FOR A PARTICULAR PURPOSE.  See the
+* GNU General Public License for more details.
+*
+* You should have received a copy of the GNU Lesser General Public
+* License along with this library.  If not, see <http://www.gnu.org/licenses/>.
+*
+* Send comments and/or bug reports to:
+*  popov.nirvana@gmail.com
+*/
+#include "Dependencies.h"
+#include <fstream>
+#include <ctype.h>
+#include <string.h>
+
+using std::filesystem::path;
+
+void Dependencies::add_file (const path& file)
+{
+	if (visited_.insert (file.lexically_normal ().string ()).second) {
+		files_.push_back (file);
+		scan (file);
+	}
+}
+
+void Dependencies::add_include (const path& name, const path& dir)
+{
+	path found;
+	if (find (name, &dir, found))
+		add_file (found);
+	else
+		complete_ = false;
+}
+
+bool Dependencies::find (const path& name, const path* dir, path& found) const
+{
+	std::error_code ec;
+	if (name.is_absolute ()) {
+		found = name;
+		return std::filesystem::is_regular_file (found, ec);
+	}
+
+	if (dir) {
+		found = *dir / name;
+		if (std::filesystem::is_regular_file (found, ec))
+			return true;
+	}
+	for (const auto& inc : include_paths_) {
+		found = inc / name;
+		if (std::filesystem::is_regular_file (found, ec))
+			return true;
+	}
+	return false;
+}
+
+void Dependencies::scan (const path& file)
+{
+	std::ifstream f (file);
+	if (!f) {
+		complete_ = false;
+		return;
+	}
+
+	path dir = file.parent_path ();
+	std::string line;
+	while (std::getline (f, line)) {
+		const char* p = line.c_str ();
+		while (isspace (*p))
+			++p;
+		if ('#' != *p)
+			continue;
+		++p;
+		while (isspace (*p))
+			++p;
+		if (strncmp (p, "include", 7))
+			continue;
+		p += 7;
+		while (isspace (*p))
+			++p;
+
+		char close;
+		if ('"' == *p)
+			close = '"';
+		else if ('<' == *p)
+			close = '>';
+		else {
+			// Macro or garbage, we can't resolve it
+			complete_ = false;
+			continue;
+		}
+		const char* begin = p + 1;
+		const char* end = strchr (begin, close);
+		if (!end) {
+			complete_ = false;
+			continue;
+		}
+
+		path found;
+		if (find (path (std::string (begin, end)), '"' == close ? &dir : nullptr, found))
+			add_file (found);
+		else
+			complete_ = false;
+	}
+}
@@ -0,0 +1,79 @@
+/*
+* Nirvana IDL to C++ compiler.
+*
+* This is a part of the Nirvana project.
+*
+* Author: Igor Popov
+*
+* Copyright (c) 2021 Igor Popov.
+*
+* This program is free software; you can redistribute it and/or modify
+* it under the terms of the GNU Lesser General Public License as published by
+* the Free Software Foundation; either version 3 of the License, or
+* (at your option) any later version.
+*
+* This program is distributed in the hope that it will be useful,
+* but WITHOUT ANY WARRANTY; without even the implied warranty of
+* MERCHANTABILITY or FITNESS FOR A PARTICULAR PURPOSE.  See the
+* GNU General Public License for more details.
+*
+* You should have received a copy of the GNU Lesser General Public
+* License along with this library.  If not, see <http://www.gnu.org/licenses/>.
+*
+* Send comments and/or bug reports to:
+*  popov.nirvana@gmail.com
+*/
+#ifndef NIDL2CPP_DEPENDENCIES_H_
+#define NIDL2CPP_DEPENDENCIES_H_
+#pragma once
+
+#include <filesystem>
+#include <string>
+#include <unordered_set>
+#include <vector>
+
+// IDL source file and all the files it includes.
+// The include directives are found by the lightweight scan without the preprocessing.
+// So the list may contain extra files from the inactive conditional blocks, but never misses
+// the file actually included.
+class Dependencies
+{
+public:
+	typedef std::vector <std::filesystem::path> Paths;
+
+	Dependencies (const Paths& include_paths) :
+		include_paths_ (include_paths),
+		complete_ (true)
+	{}
+
+	// Add the source file and its includes.
+	void add_file (const std::filesystem::path& file);
+
+	// Add the file included implicitly in the directory dir.
+	void add_include (const std::filesystem::path& name, const std::filesystem::path& dir);
+
+	// The source files followed by the included files.
+	const Paths& files () const noexcept
+	{
+		return files_;
+	}
+
+	// `false` if some include directive can not be resolved.
+	bool complete () const noexcept
+	{
+		return complete_;
+	}
+
+private:
+	void scan (const std::filesystem::path& file);
+	bool find (const std::filesystem::path& name, const std::filesystem::path* dir,
+		std::filesystem::path& found) const;
+
+private:
+	const Paths include_paths_;
+	Paths files_;
+	std::unordered_set <std::string> visited_;
+	bool complete_;
+};
+
+#endif
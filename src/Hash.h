@@ -0,0 +1,91 @@
+/*
+* Nirvana IDL to C++ compiler.
+*
+* This is a part of the Nirvana project.
+*
+* Author: Igor Popov
+*
+* Copyright (c) 2021 Igor Popov.
+*
+* This program is free software; you can redistribute it and/or modify
+* it under the terms of the GNU Lesser General Public License as published by
+* the Free Software Foundation; either version 3 of the License, or
+* (at your option) any later version.
+*
+* This program is distributed in the hope that it will be useful,
+* but WITHOUT ANY WARRANTY; without even the implied warranty of
+* MERCHANTABILITY or FITNESS FOR A PARTICULAR PURPOSE.  See the
+* GNU General Public License for more details.
+*
+* You should have received a copy of the GNU Lesser General Public
+* License along with this library.  If not, see <http://www.gnu.org/licenses/>.
+*
+* Send comments and/or bug reports to:
+*  popov.nirvana@gmail.com
+*/
+#ifndef NIDL2CPP_HASH_H_
+#define NIDL2CPP_HASH_H_
+#pragma once
+
+#include <stdint.h>
+#include <filesystem>
+#include <fstream>
+#include <string>
+#include <string_view>
+
+// 64-bit FNV-1a hash.
+// Unlike std::hash, the result does not depend on the platform and the standard library.
+class Hash
+{
+public:
+	Hash () :
+		hash_ (0xcbf29ce484222325ULL)
+	{}
+
+	void append (const void* p, size_t size) noexcept
+	{
+		for (const uint8_t* b = (const uint8_t*)p, *end = b + size; b != end; ++b) {
+			hash_ = (hash_ ^ *b) * 0x100000001b3ULL;
+		}
+	}
+
+	// Append string with the terminating zero to separate the concatenated strings.
+	void append (std::string_view s) noexcept
+	{
+		append (s.data (), s.size ());
+		append ("", 1);
+	}
+
+	// Append the file content.
+	void append_file (const std::filesystem::path& file)
+	{
+		std::ifstream f (file, std::ios::binary);
+		char buf [4096];
+		while (f) {
+			f.read (buf, sizeof (buf));
+			append (buf, (size_t)f.gcount ());
+		}
+	}
+
+	uint64_t value () const noexcept
+	{
+		return hash_;
+	}
+
+	std::string hex () const
+	{
+		static const char digits [] = "0123456789abcdef";
+		std::string s (16, '0');
+		uint64_t h = hash_;
+		for (auto it = s.rbegin (); it != s.rend (); ++it) {
+			*it = digits [h & 0xF];
+			h >>= 4;
+		}
+		return s;
+	}
+
+private:
+	uint64_t hash_;
+};
+
+#endif
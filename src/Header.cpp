@@ -24,23 +24,43 @@
 *  popov.nirvana@gmail.com
 */
 #include "Header.h"
+#include <algorithm>
+#include <fstream>
 #include <sstream>
+#include <stdexcept>
+#include <unordered_map>
+#include <unordered_set>
 
 using std::filesystem::path;
 
 inline
-std::string Header::get_guard_macro (const path& file)
+std::string Header::get_guard_macro (const path& file, const Hash* source)
 {
 	std::string name = file.filename ().replace_extension ("").string ();
 	std::string ext = file.extension ().string ().substr (1);
 	to_upper (name);
 	to_upper (ext);
-	size_t dir_hash = std::hash <std::string> {} (
-		std::filesystem::canonical (file).parent_path ().string ());
+
+	// The file names may contain characters not allowed in the macro names
+	for (char& c : name) {
+		if (!isalnum ((unsigned char)c))
+			c = '_';
+	}
+
 	std::ostringstream ss;
-	ss <<  "IDL_"
-		<< std::setfill ('0') << std::setw (sizeof (size_t) * 2) << std::hex << dir_hash
-		<< '_' << name << '_' << ext << '_';
+	ss << "IDL_";
+	if (source) {
+		// The source content and the header name identify the header
+		// independently of the directory.
+		Hash hash = *source;
+		hash.append (file.filename ().string ());
+		ss << hash.hex ();
+	} else {
+		size_t dir_hash = std::hash <std::string> {} (
+			std::filesystem::weakly_canonical (file).parent_path ().string ());
+		ss << std::setfill ('0') << std::setw (sizeof (size_t) * 2) << std::hex << dir_hash;
+	}
+	ss << '_' << name << '_' << ext << '_';
 	return ss.str ();
 }
 
@@ -50,12 +70,19 @@ void Header::to_upper (std::string& s)
 		c = toupper (c);
 }
 
-Header::Header (const path& file, const AST::Root& root) :
-	Code (file, root)
+Header::Header (const path& file, const AST::Root& root, bool reproducible) :
+	Code (file, root),
+	reproducible_ (reproducible)
 {
-	std::string guard = get_guard_macro (file);
+	// The source is hashed once for all the shards
+	if (reproducible)
+		source_.append_file (root.file ());
+
+	banner_end_ = content ().size ();
+	std::string guard = get_guard_macro (file, reproducible ? &source_ : nullptr);
 	*this << "#ifndef " << guard << std::endl;
 	*this << "#define " << guard << std::endl;
+	body_begin_ = content ().size ();
 }
 
 void Header::close ()
@@ -65,3 +92,120 @@ void Header::close ()
 	*this << "#endif\n";
 	Code::close ();
 }
+
+std::vector <path> Header::split (const ShardDeps& deps)
+{
+	const Sections& sections = this->sections ();
+	assert (deps.size () == sections.size ());
+	const std::string& text = content ();
+
+	// Shard names.
+	// The scopes are delimited by dots, which do not occur in the identifiers.
+	// The preceding sections of the same definition are the forward declarations.
+	// The suffix .fwd can't collide with a definition name, because the module
+	// can't have the same name as the definition in the same scope.
+	std::unordered_map <std::string_view, unsigned> remaining;
+	for (const auto& sec : sections) {
+		++remaining [sec.name];
+	}
+	std::vector <path> shards;
+	shards.reserve (sections.size ());
+	std::unordered_set <std::string> names;
+	const std::string stem = file ().stem ().string ();
+	for (const auto& sec : sections) {
+		std::string name = stem;
+		for (size_t pos = 0; pos < sec.name.size ();) {
+			if (!sec.name.compare (pos, 2, "::")) {
+				name += '.';
+				pos += 2;
+			} else
+				name += sec.name [pos++];
+		}
+		unsigned later = --remaining [sec.name];
+		if (later) {
+			name += ".fwd";
+			if (later > 1)
+				name += std::to_string (later);
+		}
+		name += ".h";
+		if (!names.insert (name).second)
+			throw std::runtime_error ("Duplicate client header shard " + name);
+		shards.push_back (file ().parent_path () / name);
+	}
+
+	// The fingerprints describe the definitions, they are written before the sections move.
+	write_fingerprints ();
+	remove_stale_shards (shards);
+
+	// The code outside the sections stays in this header.
+	// The shards also get the include directives found there.
+	const std::string_view banner (text.data (), banner_end_);
+	std::string umbrella;
+	std::string includes;
+	size_t pos = 0;
+	for (size_t i = 0; i < sections.size (); ++i) {
+		const Section& sec = sections [i];
+		umbrella.append (text, pos, sec.begin - pos);
+		for (size_t line = std::max (pos, body_begin_); line < sec.begin;) {
+			size_t eol = text.find ('\n', line);
+			if (eol == std::string::npos || eol > sec.begin)
+				eol = sec.begin;
+			if (!text.compare (line, 9, "#include "))
+				includes.append (text, line, eol - line).append (1, '\n');
+			line = eol + 1;
+		}
+		pos = sec.end;
+
+		const std::string shard_name = shards [i].filename ().string ();
+		umbrella += "#include \"" + shard_name + "\"\n";
+
+		std::string guard = get_guard_macro (shards [i], reproducible_ ? &source_ : nullptr);
+		std::string shard (banner);
+		shard += "#ifndef " + guard + "\n"
+			"#define " + guard + "\n";
+		shard += includes;
+		for (size_t dep : deps [i]) {
+			assert (dep < i);
+			shard += "#include \"" + shards [dep].filename ().string () + "\"\n";
+		}
+		shard.append (text, sec.begin, sec.end - sec.begin);
+		shard += "\n#endif\n";
+		add_shard (shards [i]);
+		write_if_changed (shards [i], shard);
+	}
+	umbrella.append (text, pos, std::string::npos);
+
+	replace_content (umbrella);
+	return shards;
+}
+
+void Header::remove_stale_shards (const std::vector <path>& shards) const
+{
+	// The shards of the previous run are included by the old umbrella header.
+	// The included file is a shard if it was generated from the same source.
+	std::ifstream old (file ());
+	if (!old)
+		return;
+
+	static const char INCLUDE [] = "#include \"";
+	const std::string prefix = INCLUDE + file ().stem ().string () + '.';
+	const std::string_view banner (content ().data (), content ().find ('\n'));
+	std::string line;
+	while (std::getline (old, line)) {
+		if (!line.starts_with (prefix) || !line.ends_with ('"'))
+			continue;
+		const size_t begin = sizeof (INCLUDE) - 1;
+		path shard = file ().parent_path () / line.substr (begin, line.size () - begin - 1);
+		if (std::find (shards.begin (), shards.end (), shard) != shards.end ())
+			continue;
+		std::string first_line;
+		{
+			std::ifstream f (shard);
+			std::getline (f, first_line);
+		}
+		if (first_line == banner) {
+			std::error_code ec;
+			std::filesystem::remove (shard, ec);
+		}
+	}
+}
@@ -28,18 +28,38 @@
 #pragma once
 
 #include "Code.h"
+#include "Hash.h"
 
 // C++ header file output.
 class Header : public Code
 {
 public:
-	Header (const std::filesystem::path& file, const AST::Root& root);
+	// If reproducible is `true`, the output does not depend on the file location.
+	Header (const std::filesystem::path& file, const AST::Root& root, bool reproducible);
 
 	void close ();
 
+	typedef std::vector <std::vector <size_t> > ShardDeps;
+
+	// Move each section to a separate header (shard) <stem>.<scope>.<name>[.fwd<N>].h.
+	// This header includes all the shards in the section order.
+	// deps [i] are the indexes of the preceding sections used by the section i.
+	// The shards of the previous run which are not generated now are removed.
+	// Returns the shard files.
+	std::vector <std::filesystem::path> split (const ShardDeps& deps);
+
 private:
+	void remove_stale_shards (const std::vector <std::filesystem::path>& shards) const;
+
 	static void to_upper (std::string& s);
-	static std::string get_guard_macro (const std::filesystem::path& file);
+	// If source is not null, the macro is based on the source hash instead of the directory.
+	static std::string get_guard_macro (const std::filesystem::path& file, const Hash* source);
+
+private:
+	bool reproducible_;
+	Hash source_; // IDL content hash, if reproducible
+	size_t banner_end_; // End of the generator banner
+	size_t body_begin_; // End of the include guard
 };
 
 #endif
@@ -0,0 +1,186 @@
+/*
+* Nirvana IDL to C++ compiler.
+*
+* This is a part of the Nirvana project.
+*
+* Author: Igor Popov
+*
+* Copyright (c) 2021 Igor Popov.
+*
+* This program is free software; you can redistribute it and/or modify
+* it under the terms of the GNU Lesser General Public License as published by
+* the Free Software Foundation; either version 3 of the License, or
+* (at your option) any later version.
+*
+* This program is distributed in the hope that it will be useful,
+* but WITHOUT ANY WARRANTY; without even the implied warranty of
+* MERCHANTABILITY or FITNESS FOR A PARTICULAR PURPOSE.  See the
+* GNU General Public License for more details.
+*
+* You should have received a copy of the GNU Lesser General Public
+* License along with this library.  If not, see <http://www.gnu.org/licenses/>.
+*
+* Send comments and/or bug reports to:
+*  popov.nirvana@gmail.com
+*/
+#include "Jobs.h"
+#include <atomic>
+#include <cctype>
+#include <cerrno>
+#include <cstdlib>
+#include <exception>
+#include <iostream>
+#include <mutex>
+#include <thread>
+#ifndef _WIN32
+#include <sys/wait.h>
+#include <unistd.h>
+#endif
+
+void Jobs::quote (const std::string& arg, std::string& cmd)
+{
+#ifdef _WIN32
+	cmd += '"';
+	for (char c : arg) {
+		if ('"' == c)
+			cmd += '\\';
+		cmd += c;
+	}
+	cmd += '"';
+#else
+	cmd += '\'';
+	for (char c : arg) {
+		if ('\'' == c)
+			cmd += "'\\''";
+		else
+			cmd += c;
+	}
+	cmd += '\'';
+#endif
+}
+
+std::string Jobs::command_line (const Arguments& args)
+{
+	std::string cmd;
+	for (const auto& arg : args) {
+		if (!cmd.empty ())
+			cmd += ' ';
+		quote (arg, cmd);
+	}
+#ifdef _WIN32
+	// cmd.exe strips the outer quotes
+	cmd.insert (0, 1, '"');
+	cmd += '"';
+#endif
+	return cmd;
+}
+
+std::vector <char*> Jobs::argv (const Arguments& args)
+{
+	std::vector <char*> argv;
+	argv.reserve (args.size () + 1);
+	for (const auto& arg : args) {
+		argv.push_back (const_cast <char*> (arg.c_str ()));
+	}
+	argv.push_back (nullptr);
+	return argv;
+}
+
+bool Jobs::run (size_t count, unsigned threads, const Task& task)
+{
+	std::atomic <size_t> next (0);
+	std::atomic <bool> failed (false);
+	std::mutex exception_mutex;
+	std::exception_ptr exception;
+	auto worker = [&] () {
+		for (size_t i; (i = next++) < count;) {
+			try {
+				if (!task (i))
+					failed = true;
+			} catch (...) {
+				failed = true;
+				std::lock_guard <std::mutex> lock (exception_mutex);
+				if (!exception)
+					exception = std::current_exception ();
+			}
+		}
+	};
+
+	if (threads > count)
+		threads = (unsigned)count;
+	std::vector <std::thread> workers;
+	while (threads-- > 1) {
+		workers.emplace_back (worker);
+	}
+	worker ();
+	for (auto& t : workers) {
+		t.join ();
+	}
+
+	if (exception)
+		std::rethrow_exception (exception);
+	return !failed;
+}
+
+bool Jobs::split (const std::string& line, Arguments& args)
+{
+	auto it = line.begin ();
+	for (;;) {
+		while (it != line.end () && isspace ((unsigned char)*it))
+			++it;
+		if (it == line.end ())
+			break;
+
+		std::string arg;
+		while (it != line.end () && !isspace ((unsigned char)*it)) {
+			char c = *it++;
+			if ('"' == c || '\'' == c) {
+				char q = c;
+				for (;;) {
+					if (it == line.end ())
+						return false;
+					c = *it++;
+					if (q == c)
+						break;
+					if ('\\' == c && '"' == q && it != line.end () && ('"' == *it || '\\' == *it))
+						c = *it++;
+					arg += c;
+				}
+			} else if ('\\' == c && it != line.end ())
+				arg += *it++;
+			else
+				arg += c;
+		}
+		args.push_back (std::move (arg));
+	}
+	return true;
+}
+
+int Jobs::execute (const Arguments& args, Main main)
+{
+	std::cout.flush ();
+	std::cerr.flush ();
+
+#ifdef _WIN32
+	(void)main;
+	return std::system (command_line (args).c_str ());
+#else
+	pid_t pid = fork ();
+	if (pid < 0)
+		return EXIT_FAILURE;
+
+	if (0 == pid) {
+		// The standard output is reserved for the parent
+		dup2 (STDERR_FILENO, STDOUT_FILENO);
+
+		std::exit (main ((int)args.size (), argv (args).data ()));
+	}
+
+	int status;
+	while (waitpid (pid, &status, 0) < 0) {
+		if (EINTR != errno)
+			return EXIT_FAILURE;
+	}
+	return WIFEXITED (status) ? WEXITSTATUS (status) : EXIT_FAILURE;
+#endif
+}
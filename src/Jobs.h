@@ -0,0 +1,68 @@
+/*
+* Nirvana IDL to C++ compiler.
+*
+* This is a part of the Nirvana project.
+*
+* Author: Igor Popov
+*
+* Copyright (c) 2021 Igor Popov.
+*
+* This program is free software; you can redistribute it and/or modify
+* it under the terms of the GNU Lesser General Public License as published by
+* the Free Software Foundation; either version 3 of the License, or
+* (at your option) any later version.
+*
+* This program is distributed in the hope that it will be useful,
+* but WITHOUT ANY WARRANTY; without even the implied warranty of
+* MERCHANTABILITY or FITNESS FOR A PARTICULAR PURPOSE.  See the
+* GNU General Public License for more details.
+*
+* You should have received a copy of the GNU Lesser General Public
+* License along with this library.  If not, see <http://www.gnu.org/licenses/>.
+*
+* Send comments and/or bug reports to:
+*  popov.nirvana@gmail.com
+*/
+#ifndef NIDL2CPP_JOBS_H_
+#define NIDL2CPP_JOBS_H_
+#pragma once
+
+#include <functional>
+#include <string>
+#include <vector>
+
+// Compiler jobs running.
+class Jobs
+{
+public:
+	typedef std::vector <std::string> Arguments;
+
+	// Build the shell command line from the argument list.
+	static std::string command_line (const Arguments& args);
+
+	// Build the null terminated argv array, pointing to the `args` strings.
+	static std::vector <char*> argv (const Arguments& args);
+
+	// Job task, returns `false` on failure.
+	typedef std::function <bool (size_t)> Task;
+
+	// Run tasks 0..count-1 in parallel using up to `threads` worker threads.
+	// Returns `false` if any of the tasks failed.
+	// The first exception thrown by a task is rethrown after all the tasks are done.
+	static bool run (size_t count, unsigned threads, const Task& task);
+
+	// Split the command line to the arguments and append them to `args`.
+	// Returns `false` if the closing quote is missed.
+	static bool split (const std::string& line, Arguments& args);
+
+	typedef int (*Main) (int argc, char* argv []);
+
+	// Call `main` in the child process and return its exit code.
+	// Falls back to the shell command where fork is not available.
+	static int execute (const Arguments& args, Main main);
+
+private:
+	static void quote (const std::string& arg, std::string& cmd);
+};
+
+#endif
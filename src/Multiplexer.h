@@ -0,0 +1,241 @@
+/*
+* Nirvana IDL to C++ compiler.
+*
+* This is a part of the Nirvana project.
+*
+* Author: Igor Popov
+*
+* Copyright (c) 2021 Igor Popov.
+*
+* This program is free software; you can redistribute it and/or modify
+* it under the terms of the GNU Lesser General Public License as published by
+* the Free Software Foundation; either version 3 of the License, or
+* (at your option) any later version.
+*
+* This program is distributed in the hope that it will be useful,
+* but WITHOUT ANY WARRANTY; without even the implied warranty of
+* MERCHANTABILITY or FITNESS FOR A PARTICULAR PURPOSE.  See the
+* GNU General Public License for more details.
+*
+* You should have received a copy of the GNU Lesser General Public
+* License along with this library.  If not, see <http://www.gnu.org/licenses/>.
+*
+* Send comments and/or bug reports to:
+*  popov.nirvana@gmail.com
+*/
+#ifndef NIDL2CPP_MULTIPLEXER_H_
+#define NIDL2CPP_MULTIPLEXER_H_
+#pragma once
+
+#include "CodeGenBase.h"
+#include <type_traits>
+#include <vector>
+
+// Code generator which passes each AST node to several generators in order.
+// Generates all the files in a single tree traversal.
+// Marks the output sections of the top-level definitions.
+class Multiplexer : public AST::CodeGen
+{
+public:
+	void add (CodeGenBase& cg)
+	{
+		generators_.push_back (&cg);
+	}
+
+	virtual void end (const AST::Root& item) override
+	{
+		end_all (item);
+	}
+
+	virtual void leaf (const AST::Include& item) override
+	{
+		leaf_all (item);
+	}
+
+	virtual void leaf (const AST::Native& item) override
+	{
+		leaf_all (item);
+	}
+
+	virtual void leaf (const AST::TypeDef& item) override
+	{
+		leaf_all (item);
+	}
+
+	virtual void begin (const AST::ModuleItems& item) override
+	{
+		begin_all (item);
+	}
+
+	virtual void end (const AST::ModuleItems& item) override
+	{
+		end_all (item);
+	}
+
+	virtual void leaf (const AST::Operation& item) override
+	{
+		leaf_all (item);
+	}
+
+	virtual void leaf (const AST::Attribute& item) override
+	{
+		leaf_all (item);
+	}
+
+	virtual void leaf (const AST::InterfaceDecl& item) override
+	{
+		leaf_all (item);
+	}
+
+	virtual void begin (const AST::Interface& item) override
+	{
+		begin_type (item);
+	}
+
+	virtual void end (const AST::Interface& item) override
+	{
+		end_type (item);
+	}
+
+	virtual void leaf (const AST::Constant& item) override
+	{
+		leaf_all (item);
+	}
+
+	virtual void leaf (const AST::Exception& item) override
+	{
+		leaf_all (item);
+	}
+
+	virtual void leaf (const AST::StructDecl& item) override
+	{
+		leaf_all (item);
+	}
+
+	virtual void leaf (const AST::Struct& item) override
+	{
+		leaf_all (item);
+	}
+
+	virtual void leaf (const AST::Enum& item) override
+	{
+		leaf_all (item);
+	}
+
+	virtual void leaf (const AST::UnionDecl& item) override
+	{
+		leaf_all (item);
+	}
+
+	virtual void leaf (const AST::Union& item) override
+	{
+		leaf_all (item);
+	}
+
+	virtual void leaf (const AST::ValueTypeDecl& item) override
+	{
+		leaf_all (item);
+	}
+
+	virtual void begin (const AST::ValueType& item) override
+	{
+		begin_type (item);
+	}
+
+	virtual void end (const AST::ValueType& item) override
+	{
+		end_type (item);
+	}
+
+	virtual void leaf (const AST::StateMember& item) override
+	{
+		leaf_all (item);
+	}
+
+	virtual void leaf (const AST::ValueFactory& item) override
+	{
+		leaf_all (item);
+	}
+
+	virtual void leaf (const AST::ValueBox& item) override
+	{
+		leaf_all (item);
+	}
+
+private:
+	// The definitions nested in interfaces and value types
+	// belong to the section of the enclosing type.
+	static bool is_top_level (const AST::NamedItem& item)
+	{
+		const AST::ItemScope* parent = item.parent ();
+		return !parent || parent->kind () == AST::Item::Kind::MODULE;
+	}
+
+	// The CodeGen callbacks are protected in CodeGenBase
+	static AST::CodeGen& codegen (CodeGenBase* cg) noexcept
+	{
+		return *cg;
+	}
+
+	template <class I>
+	void leaf_all (const I& item)
+	{
+		if constexpr (std::is_base_of_v <AST::NamedItem, I>) {
+			if (is_top_level (item)) {
+				for (auto cg : generators_) {
+					cg->section_begin (item);
+					codegen (cg).leaf (item);
+					cg->section_end ();
+				}
+				return;
+			}
+		}
+		for (auto cg : generators_) {
+			codegen (cg).leaf (item);
+		}
+	}
+
+	template <class I>
+	void begin_all (const I& item)
+	{
+		for (auto cg : generators_) {
+			codegen (cg).begin (item);
+		}
+	}
+
+	template <class I>
+	void end_all (const I& item)
+	{
+		for (auto cg : generators_) {
+			codegen (cg).end (item);
+		}
+	}
+
+	// Interface or value type
+	template <class I>
+	void begin_type (const I& item)
+	{
+		bool section = is_top_level (item);
+		for (auto cg : generators_) {
+			if (section)
+				cg->section_begin (item);
+			codegen (cg).begin (item);
+		}
+	}
+
+	template <class I>
+	void end_type (const I& item)
+	{
+		bool section = is_top_level (item);
+		for (auto cg : generators_) {
+			codegen (cg).end (item);
+			if (section)
+				cg->section_end ();
+		}
+	}
+
+private:
+	std::vector <CodeGenBase*> generators_;
+};
+
+#endif
@@ -42,19 +42,47 @@ public:
 		legacy (false),
 		no_servant (false),
 		no_client_cpp (false),
-		no_ami (false)
+		no_ami (false),
+		no_threads (false),
+		single_pass (false),
+		make_deps (false),
+		stats (false),
+		reproducible (false),
+		fingerprints (false),
+		watch (false),
+		verbose (false),
+		client_shards (false),
+		modules (false),
+		jobs (1),
+		proxy_shards (1)
 	{}
 
 	std::filesystem::path out_h, out_cpp, out_proxy;
+	std::filesystem::path cache_dir;
+	std::filesystem::path dep_file, manifest;
+	std::filesystem::path stats_json;
 	std::string client_suffix;
 	std::string servant_suffix;
 	std::string proxy_suffix;
 	std::string inc_cpp;
+	std::string module_prefix;
 	bool client, server, proxy;
 	bool legacy;
 	bool no_servant;
 	bool no_client_cpp;
 	bool no_ami;
+	bool no_threads;
+	bool single_pass;
+	bool make_deps;
+	bool stats;
+	bool reproducible;
+	bool fingerprints;
+	bool watch;
+	bool verbose;
+	bool client_shards;
+	bool modules;
+	unsigned jobs;
+	unsigned proxy_shards;
 };
 
 #endif
@@ -24,6 +24,7 @@
 *  popov.nirvana@gmail.com
 */
 #include "Proxy.h"
+#include "Hash.h"
 
 #define PREFIX_OP_PROC "__rq_"
 #define PREFIX_OP_PARAM_IN "__par_in_"
@@ -40,9 +41,38 @@ void Proxy::end (const Root&)
 		cpp_ << empty_line
 			<< "#include <" << cpp_.file ().stem ().generic_string () << "_native.h>\n";
 	}
+	if (options ().proxy_shards > 1)
+		write_shards ();
 	cpp_.close ();
 }
 
+void Proxy::set_custom ()
+{
+	custom_ = true;
+	if (!cpp_.sections ().empty ())
+		custom_sections_.insert (cpp_.sections ().back ().name);
+}
+
+void Proxy::write_shards ()
+{
+	// The definition is placed by the name hash, so adding a definition does not move the others.
+	// The custom code stays in the main file with the <name>_native.h include.
+	const std::vector <std::filesystem::path> files = compiler ().proxy_shard_files (cpp_.file ());
+	const Code::Sections& sections = cpp_.sections ();
+	std::vector <unsigned> shards;
+	shards.reserve (sections.size ());
+	for (const auto& sec : sections) {
+		unsigned shard = 0;
+		if (!custom_sections_.count (sec.name)) {
+			Hash hash;
+			hash.append (sec.name);
+			shard = (unsigned)(hash.value () % files.size ());
+		}
+		shards.push_back (shard);
+	}
+	cpp_.split (files, shards);
+}
+
 inline
 void Proxy::get_parameters (const Operation& op, Members& params_in, Members& params_out)
 {
@@ -94,7 +124,7 @@ void Proxy::implement (const Operation& op, const OpMetadata& md, bool no_rq)
 		<< " (" << QName (itf) << "* _servant, IORequest_ptr _call)";
 
 	if (is_custom (op)) {
-		custom_ = true;
+		set_custom ();
 		cpp_ << ";\n\n";
 		return;
 	}
@@ -162,7 +192,7 @@ void Proxy::implement (const Attribute& att, bool no_rq)
 			<< " (" << QName (itf) << "* _servant, IORequest_ptr _call)";
 
 		if (is_native (att)) {
-			custom_ = true;
+			set_custom ();
 			cpp_ << ";\n\n";
 			return;
 		}
@@ -230,7 +260,7 @@ void Proxy::end (const Interface& itf)
 		generate_poller (itf, *ami->poller);
 
 	cpp_.namespace_close ();
-	cpp_ << "NIRVANA_EXPORT (" << export_name (itf) << ", CORBA::Internal::RepIdOf <" << QName (itf)
+	cpp_ << "NIRVANA_EXPORT (" << ExportName (itf) << ", CORBA::Internal::RepIdOf <" << QName (itf)
 		<< ">::id, CORBA::Internal::ProxyFactory, CORBA::Internal::ProxyFactoryImpl"
 		<< " <" << QName (itf);
 
@@ -300,17 +330,6 @@ void Proxy::md_operation (const Interface& itf, const OpMetadata& op, bool no_rq
 		cpp_ << ", call <" PREFIX_OP_PROC << op.name << ">, " << flags << " }";
 }
 
-std::string Proxy::export_name (const NamedItem& item)
-{
-	std::string name = "_exp";
-	ScopedName sn = item.scoped_name ();
-	for (const auto& n : sn) {
-		name += '_';
-		name += n;
-	}
-	return name;
-}
-
 inline
 void Proxy::md_member (const Member& m)
 {
@@ -349,7 +368,7 @@ void Proxy::type_code_members (const ItemWithId& item, const Members& members)
 Code& Proxy::exp (const NamedItem& item)
 {
 	return cpp_ <<
-		"NIRVANA_EXPORT (" << export_name (item) << ", "
+		"NIRVANA_EXPORT (" << ExportName (item) << ", "
 		"CORBA::Internal::RepIdOf <" << QName (item) << ">::id, CORBA::TypeCode, CORBA::Internal::";
 }
 
@@ -407,7 +426,7 @@ void Proxy::leaf (const ValueBox& vb)
 	cpp_ << TypeCodeName (vb);
 
 	cpp_.namespace_close ();
-	cpp_ << "NIRVANA_EXPORT (" << export_name (vb) << ", CORBA::Internal::RepIdOf <" << QName (vb) << ">::id, CORBA"
+	cpp_ << "NIRVANA_EXPORT (" << ExportName (vb) << ", CORBA::Internal::RepIdOf <" << QName (vb) << ">::id, CORBA"
 		<< "::Internal::PseudoBase, CORBA::Internal::ValueBoxFactory <"
 		<< QName (vb) << ">)\n";
 }
@@ -455,7 +474,7 @@ void Proxy::generate_proxy (const Interface& itf, const Compiler::AMI_Objects* a
 		"class Proxy <" << QName (itf) << "> : public " << proxy_base << " <" << QName (itf)
 		<< indent;
 
-	Interfaces bases = itf.get_all_bases ();
+	const Interfaces& bases = get_all_bases (itf);
 	for (auto p : bases) {
 		cpp_ << ",\n" << QName (*p);
 	}
@@ -487,7 +506,9 @@ void Proxy::generate_proxy (const Interface& itf, const Compiler::AMI_Objects* a
 		<< "{}\n";
 
 	// Operations
+	// The references to the metadata elements are not kept across emplace_back.
 	Metadata metadata;
+	metadata.reserve (itf.size ());
 	for (auto it = itf.begin (); it != itf.end (); ++it) {
 		const Item& item = **it;
 		switch (item.kind ()) {
@@ -937,7 +958,7 @@ void Proxy::generate_poller (const Interface& itf, const ValueType& poller)
 
 	std::vector <const ValueType*> base_pollers;
 	{
-		Interfaces bases = itf.get_all_bases ();
+		const Interfaces& bases = get_all_bases (itf);
 		for (const auto& b : bases) {
 			auto f = compiler ().ami_interfaces ().find (b);
 			if (f != compiler ().ami_interfaces ().end ())
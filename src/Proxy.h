@@ -27,7 +27,9 @@
 #define NIDL2CPP_PROXY_H_
 #pragma once
 
-#include <list>
+#include <string>
+#include <unordered_set>
+#include <vector>
 #include "CodeGenBase.h"
 #include "Code.h"
 
@@ -35,12 +37,14 @@
 class Proxy : public CodeGenBase
 {
 public:
-	Proxy (const Compiler& compiler, const AST::Root& root,
+	Proxy (const Compiler& compiler, std::ostream& err_out, const AST::Root& root,
 		const std::filesystem::path& file, const std::filesystem::path& servant) :
-		CodeGenBase (compiler),
+		CodeGenBase (compiler, err_out),
 		cpp_ (file, root),
 		custom_ (false)
 	{
+		add_output (cpp_, compiler.proxy_shards > 1);
+
 		if (!compiler.inc_cpp.empty ())
 			cpp_ << "#include \"" << compiler.inc_cpp << "\"\n";
 
@@ -73,7 +77,20 @@ private:
 
 	static void get_parameters (const AST::Operation& op, Members& params_in, Members& params_out);
 
-	static std::string export_name (const AST::NamedItem& item);
+	// Export name _exp_<scope>_<name>
+	struct ExportName
+	{
+		ExportName (const AST::NamedItem& ni) :
+			item (ni)
+		{}
+
+		const AST::NamedItem& item;
+	};
+
+	friend Code& operator << (Code& stm, const ExportName& en)
+	{
+		return stm << "_exp_" << ScopedNameOf (en.item, '_');
+	}
 
 	struct OpMetadata
 	{
@@ -95,7 +112,7 @@ private:
 	void md_member (const AST::Member& m);
 	void md_member (const AST::Type& t, const std::string& name);
 
-	typedef std::list <OpMetadata> Metadata;
+	typedef std::vector <OpMetadata> Metadata;
 
 	void md_operation (const AST::Interface& itf, const OpMetadata& op, bool no_rq);
 
@@ -106,9 +123,15 @@ private:
 	void generate_proxy (const AST::Interface& itf, const Compiler::AMI_Objects* ami);
 	void generate_poller (const AST::Interface& itf, const AST::ValueType& poller);
 
+	void set_custom ();
+	void write_shards ();
+
 private:
 	Code cpp_;
 	bool custom_;
+
+	// The sections with the custom code implemented in <name>_native.h
+	std::unordered_set <std::string> custom_sections_;
 };
 
 Code& operator << (Code& stm, const Proxy::UserException& ue);
@@ -146,7 +146,7 @@ void Servant::end (const Interface& itf)
 	skeleton_end (itf);
 
 	// Bases
-	const Interfaces all_bases = itf.get_all_bases ();
+	const Interfaces& all_bases = get_all_bases (itf);
 
 	if (itf.interface_kind () != InterfaceKind::PSEUDO || !all_bases.empty ()) {
 		h_ << ",\n"
@@ -422,7 +422,7 @@ void Servant::end (const ValueType& vt)
 		<< indent
 		<< "S::template _wide_val <ValueBase, " << QName (vt) << '>';
 
-	const Bases all_bases = get_all_bases (vt);
+	const Bases& all_bases = get_all_bases (vt);
 
 	for (auto b : all_bases) {
 		h_ << ",\n"
@@ -434,7 +434,7 @@ void Servant::end (const ValueType& vt)
 		h_ << ",\n"
 			"S::template _wide_val <" << QName (*concrete_itf) << ", " << QName (vt) << '>';
 
-		Interfaces bases = concrete_itf->get_all_bases ();
+		const Interfaces& bases = get_all_bases (*concrete_itf);
 		for (auto b : bases) {
 			h_ << ",\n"
 				"S::template _wide_val <" << QName (*b) << ", " << QName (vt) << '>';
@@ -1058,13 +1058,11 @@ void Servant::leaf (const Operation& op)
 
 const NamedItem* Servant::find_item (const Interface& itf, const Identifier& name, Item::Kind kind)
 {
-	for (auto item : itf) {
-		if (item->kind () == kind) {
-			const NamedItem& ni = static_cast <const NamedItem&> (*item);
-			if (ni.name () == name)
-				return &ni;
-		}
-	}
+	// The interface scope symbol table is indexed by name, don't scan the items.
+	// The symbol lookup may be case-insensitive, so compare the name.
+	const NamedItem* item = itf.find (name);
+	if (item && item->kind () == kind && item->name () == name)
+		return item;
 	return nullptr;
 }
 
@@ -1332,14 +1330,7 @@ void Servant::leaf (const Constant& c)
 
 const Operation* Servant::find_operation (const Interface& itf, const Identifier& name)
 {
-	for (const auto& item : itf) {
-		if (item->kind () == Item::Kind::OPERATION) {
-			const Operation& op = static_cast <const Operation&> (*item);
-			if (op.name () == name)
-				return &op;
-		}
-	}
-	return nullptr;
+	return static_cast <const Operation*> (find_item (itf, name, Item::Kind::OPERATION));
 }
 
 Code& operator << (Code& stm, const Servant::ABI2Servant& val)
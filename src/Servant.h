@@ -35,12 +35,13 @@
 class Servant : public CodeGenBase
 {
 public:
-	Servant (const Compiler& compiler, const AST::Root& root,
+	Servant (const Compiler& compiler, std::ostream& err_out, const AST::Root& root,
 		const std::filesystem::path& file, const std::filesystem::path& client) :
-		CodeGenBase (compiler),
-		h_ (file, root),
+		CodeGenBase (compiler, err_out),
+		h_ (file, root, compiler.reproducible),
 		attributes_by_ref_ (false)
 	{
+		add_output (h_);
 		h_ << "#include " << client.filename () << std::endl << std::endl;
 	}
 
@@ -0,0 +1,141 @@
+/*
+* Nirvana IDL to C++ compiler.
+*
+* This is a part of the Nirvana project.
+*
+* Author: Igor Popov
+*
+* Copyright (c) 2021 Igor Popov.
+*
+* This program is free software; you can redistribute it and/or modify
+* it under the terms of the GNU Lesser General Public License as published by
+* the Free Software Foundation; either version 3 of the License, or
+* (at your option) any later version.
+*
+* This program is distributed in the hope that it will be useful,
+* but WITHOUT ANY WARRANTY; without even the implied warranty of
+* MERCHANTABILITY or FITNESS FOR A PARTICULAR PURPOSE.  See the
+* GNU General Public License for more details.
+*
+* You should have received a copy of the GNU Lesser General Public
+* License along with this library.  If not, see <http://www.gnu.org/licenses/>.
+*
+* Send comments and/or bug reports to:
+*  popov.nirvana@gmail.com
+*/
+#include "Stats.h"
+#include <iomanip>
+
+#ifdef _WIN32
+#include <Windows.h>
+#include <Psapi.h>
+#else
+#include <sys/resource.h>
+#endif
+
+void Stats::print (std::ostream& out) const
+{
+	auto flags = out.flags ();
+	auto precision = out.precision ();
+	out << std::fixed << std::setprecision (3);
+
+	out << "Statistics for " << file.string () << ":\n";
+	if (cached)
+		out << "\tRestored from the cache\n";
+	out <<
+		"\tFront end:    " << std::setw (10) << front_end * 1000 << " ms\n"
+		"\tAMI:          " << std::setw (10) << ami * 1000 << " ms\n";
+	for (const auto& gen : generators) {
+		out << '\t' << std::left << std::setw (14) << (std::string (gen.first) + ':')
+			<< std::right << std::setw (10) << gen.second * 1000 << " ms\n";
+	}
+	out << "\tInterfaces: " << interfaces
+		<< ", operations: " << operations
+		<< ", AMI pollers and handlers: " << ami_objects << '\n';
+	for (const auto& output : outputs) {
+		out << '\t' << output.first.string () << ": " << output.second << " bytes\n";
+	}
+	uintmax_t rss = peak_rss ();
+	if (rss)
+		out << "\tPeak RSS: " << rss / 1024 << " KB\n";
+
+	out.flags (flags);
+	out.precision (precision);
+}
+
+void Stats::print_json (std::ostream& out) const
+{
+	out << "{\"file\":";
+	json_string (out, file.generic_string ());
+	out << ",\"cached\":" << (cached ? "true" : "false")
+		<< ",\"front_end\":" << front_end
+		<< ",\"ami\":" << ami
+		<< ",\"generators\":{";
+	for (auto it = generators.begin (); it != generators.end (); ++it) {
+		if (it != generators.begin ())
+			out << ',';
+		json_string (out, it->first);
+		out << ':' << it->second;
+	}
+	out << "},\"interfaces\":" << interfaces
+		<< ",\"operations\":" << operations
+		<< ",\"ami_objects\":" << ami_objects
+		<< ",\"outputs\":{";
+	for (auto it = outputs.begin (); it != outputs.end (); ++it) {
+		if (it != outputs.begin ())
+			out << ',';
+		json_string (out, it->first.generic_string ());
+		out << ':' << it->second;
+	}
+	out << "},\"peak_rss\":" << peak_rss () << "}\n";
+}
+
+void Stats::add_outputs (const std::vector <std::filesystem::path>& files)
+{
+	for (const auto& f : files) {
+		std::error_code ec;
+		uintmax_t size = std::filesystem::file_size (f, ec);
+		outputs.emplace_back (f, ec ? 0 : size);
+	}
+}
+
+void Stats::json_string (std::ostream& out, const std::string& s)
+{
+	out << '"';
+	for (char c : s) {
+		switch (c) {
+			case '"':
+				out << "\\\"";
+				break;
+			case '\\':
+				out << "\\\\";
+				break;
+			default:
+				if ((unsigned char)c < 0x20) {
+					static const char digits [] = "0123456789abcdef";
+					out << "\\u00" << digits [c >> 4] << digits [c & 0xF];
+				} else
+					out << c;
+		}
+	}
+	out << '"';
+}
+
+uintmax_t Stats::peak_rss ()
+{
+#ifdef _WIN32
+	PROCESS_MEMORY_COUNTERS pmc;
+	if (GetProcessMemoryInfo (GetCurrentProcess (), &pmc, sizeof (pmc)))
+		return pmc.PeakWorkingSetSize;
+	return 0;
+#else
+	struct rusage ru;
+	if (getrusage (RUSAGE_SELF, &ru))
+		return 0;
+#ifdef __APPLE__
+	return ru.ru_maxrss;
+#else
+	return (uintmax_t)ru.ru_maxrss * 1024;
+#endif
+#endif
+}
@@ -0,0 +1,88 @@
+/*
+* Nirvana IDL to C++ compiler.
+*
+* This is a part of the Nirvana project.
+*
+* Author: Igor Popov
+*
+* Copyright (c) 2021 Igor Popov.
+*
+* This program is free software; you can redistribute it and/or modify
+* it under the terms of the GNU Lesser General Public License as published by
+* the Free Software Foundation; either version 3 of the License, or
+* (at your option) any later version.
+*
+* This program is distributed in the hope that it will be useful,
+* but WITHOUT ANY WARRANTY; without even the implied warranty of
+* MERCHANTABILITY or FITNESS FOR A PARTICULAR PURPOSE.  See the
+* GNU General Public License for more details.
+*
+* You should have received a copy of the GNU Lesser General Public
+* License along with this library.  If not, see <http://www.gnu.org/licenses/>.
+*
+* Send comments and/or bug reports to:
+*  popov.nirvana@gmail.com
+*/
+#ifndef NIDL2CPP_STATS_H_
+#define NIDL2CPP_STATS_H_
+#pragma once
+
+#include <chrono>
+#include <filesystem>
+#include <ostream>
+#include <stdint.h>
+#include <string>
+#include <vector>
+
+// Compilation statistics for one IDL file.
+struct Stats
+{
+	typedef std::chrono::steady_clock Clock;
+
+	static double seconds (Clock::time_point begin, Clock::time_point end = Clock::now ())
+	{
+		return std::chrono::duration <double> (end - begin).count ();
+	}
+
+	std::filesystem::path file;
+
+	// Time in seconds
+	double front_end; // Preprocessing and parsing, excluding AMI
+	double ami;       // AMI objects synthesis
+	std::vector <std::pair <const char*, double> > generators;
+
+	unsigned interfaces;
+	unsigned operations;
+	unsigned ami_objects; // Synthesized pollers and handlers
+
+	std::vector <std::pair <std::filesystem::path, uintmax_t> > outputs;
+
+	bool cached; // The outputs were restored from the cache
+
+	Stats () :
+		front_end (0),
+		ami (0),
+		interfaces (0),
+		operations (0),
+		ami_objects (0),
+		cached (false)
+	{}
+
+	// Add the output files with their sizes.
+	void add_outputs (const std::vector <std::filesystem::path>& files);
+
+	// Human readable report
+	void print (std::ostream& out) const;
+
+	// Report as a single line JSON object
+	void print_json (std::ostream& out) const;
+
+	// Peak resident set size of the process in bytes.
+	// Returns 0 if not supported.
+	static uintmax_t peak_rss ();
+
+private:
+	static void json_string (std::ostream& out, const std::string& s);
+};
+
+#endif
@@ -0,0 +1,176 @@
+/*
+* Nirvana IDL to C++ compiler.
+*
+* This is a part of the Nirvana project.
+*
+* Author: Igor Popov
+*
+* Copyright (c) 2021 Igor Popov.
+*
+* This program is free software; you can redistribute it and/or modify
+* it under the terms of the GNU Lesser General Public License as published by
+* the Free Software Foundation; either version 3 of the License, or
+* (at your option) any later version.
+*
+* This program is distributed in the hope that it will be useful,
+* but WITHOUT ANY WARRANTY; without even the implied warranty of
+* MERCHANTABILITY or FITNESS FOR A PARTICULAR PURPOSE.  See the
+* GNU General Public License for more details.
+*
+* You should have received a copy of the GNU Lesser General Public
+* License along with this library.  If not, see <http://www.gnu.org/licenses/>.
+*
+* Send comments and/or bug reports to:
+*  popov.nirvana@gmail.com
+*/
+#include "Watcher.h"
+#include <algorithm>
+#include <cerrno>
+#include <chrono>
+#include <string>
+#include <system_error>
+#include <thread>
+#ifdef __linux__
+#include <poll.h>
+#include <sys/inotify.h>
+#include <unistd.h>
+#endif
+
+using std::filesystem::path;
+
+Watcher::Watcher ()
+#ifdef __linux__
+	: fd_ (inotify_init1 (IN_CLOEXEC))
+#endif
+{}
+
+Watcher::~Watcher ()
+{
+#ifdef __linux__
+	if (fd_ >= 0)
+		close (fd_);
+#endif
+}
+
+void Watcher::snapshot (const Paths& files)
+{
+	files_ = files;
+	times_.clear ();
+	times_.reserve (files.size ());
+	for (const auto& f : files) {
+		times_.push_back (mtime (f));
+	}
+
+#ifdef __linux__
+	if (fd_ >= 0) {
+		// The queued events are older than the snapshot
+		while (read_events (0, nullptr))
+			;
+
+		watched_.clear ();
+		for (size_t i = 0; i < files.size (); ++i) {
+			path abs = std::filesystem::absolute (files [i]).lexically_normal ();
+			path dir = abs.parent_path ();
+			int wd = inotify_add_watch (fd_, dir.c_str (),
+				IN_CLOSE_WRITE | IN_CREATE | IN_DELETE | IN_MOVED_FROM | IN_MOVED_TO);
+			if (wd < 0) {
+				// The watch limit is exceeded, fall back to polling
+				close (fd_);
+				fd_ = -1;
+				directories_.clear ();
+				watched_.clear ();
+				break;
+			}
+			directories_ [wd] = dir;
+			watched_.emplace (abs.string (), i);
+		}
+	}
+#endif
+}
+
+Watcher::Paths Watcher::wait ()
+{
+#ifdef __linux__
+	if (fd_ >= 0)
+		return wait_inotify ();
+#endif
+	return poll ();
+}
+
+Watcher::Time Watcher::mtime (const path& file)
+{
+	std::error_code ec;
+	Time t = std::filesystem::last_write_time (file, ec);
+	return ec ? Time::min () : t;
+}
+
+Watcher::Paths Watcher::poll () const
+{
+	for (;;) {
+		std::this_thread::sleep_for (std::chrono::milliseconds (500));
+		Paths changed;
+		for (size_t i = 0; i < files_.size (); ++i) {
+			if (mtime (files_ [i]) != times_ [i])
+				changed.push_back (files_ [i]);
+		}
+		if (!changed.empty ())
+			return changed;
+	}
+}
+
+#ifdef __linux__
+
+Watcher::Paths Watcher::wait_inotify ()
+{
+	// Editors may save the file in several steps.
+	// Collect the events until the short pause.
+	Paths changed;
+	int timeout = -1;
+	while (read_events (timeout, &changed)) {
+		if (!changed.empty ())
+			timeout = 100;
+	}
+	return changed;
+}
+
+bool Watcher::read_events (int timeout, Paths* changed)
+{
+	pollfd pfd { fd_, POLLIN, 0 };
+	int cnt;
+	while ((cnt = ::poll (&pfd, 1, timeout)) < 0) {
+		if (EINTR != errno)
+			throw std::system_error (errno, std::generic_category (), "poll");
+	}
+	if (!cnt)
+		return false;
+
+	alignas (inotify_event) char buf [4096];
+	ssize_t cb;
+	while ((cb = read (fd_, buf, sizeof (buf))) < 0) {
+		if (EINTR != errno)
+			throw std::system_error (errno, std::generic_category (), "inotify");
+	}
+
+	for (const char* p = buf; p < buf + cb;) {
+		const inotify_event* ev = (const inotify_event*)p;
+		p += sizeof (inotify_event) + ev->len;
+		if (ev->mask & IN_IGNORED) {
+			directories_.erase (ev->wd);
+			continue;
+		}
+		if (!changed || !ev->len)
+			continue;
+		auto dir = directories_.find (ev->wd);
+		if (dir == directories_.end ())
+			continue;
+		auto f = watched_.find ((dir->second / ev->name).string ());
+		if (f != watched_.end ()) {
+			const path& file = files_ [f->second];
+			if (std::find (changed->begin (), changed->end (), file) == changed->end ())
+				changed->push_back (file);
+		}
+	}
+	return true;
+}
+
+#endif
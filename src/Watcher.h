@@ -0,0 +1,83 @@
+/*
+* Nirvana IDL to C++ compiler.
+*
+* This is a part of the Nirvana project.
+*
+* Author: Igor Popov
+*
+* Copyright (c) 2021 Igor Popov.
+*
+* This program is free software; you can redistribute it and/or modify
+* it under the terms of the GNU Lesser General Public License as published by
+* the Free Software Foundation; either version 3 of the License, or
+* (at your option) any later version.
+*
+* This program is distributed in the hope that it will be useful,
+* but WITHOUT ANY WARRANTY; without even the implied warranty of
+* MERCHANTABILITY or FITNESS FOR A PARTICULAR PURPOSE.  See the
+* GNU General Public License for more details.
+*
+* You should have received a copy of the GNU Lesser General Public
+* License along with this library.  If not, see <http://www.gnu.org/licenses/>.
+*
+* Send comments and/or bug reports to:
+*  popov.nirvana@gmail.com
+*/
+#ifndef NIDL2CPP_WATCHER_H_
+#define NIDL2CPP_WATCHER_H_
+#pragma once
+
+#include <filesystem>
+#include <string>
+#include <unordered_map>
+#include <vector>
+
+// Waits for the file changes.
+// Uses inotify on Linux and polls the file modification times elsewhere.
+class Watcher
+{
+public:
+	typedef std::vector <std::filesystem::path> Paths;
+
+	Watcher ();
+	~Watcher ();
+
+	Watcher (const Watcher&) = delete;
+	Watcher& operator = (const Watcher&) = delete;
+
+	// Remember the state of the files.
+	// All the changes made after the call are reported by wait ().
+	void snapshot (const Paths& files);
+
+	// Wait until any of the snapshot files is created, modified or removed.
+	// Returns the changed files.
+	Paths wait ();
+
+private:
+	typedef std::filesystem::file_time_type Time;
+
+	static Time mtime (const std::filesystem::path& file);
+	Paths poll () const;
+
+#ifdef __linux__
+	Paths wait_inotify ();
+
+	// Read the queued events and collect the changed files, if changed is not null.
+	// Returns `false` on timeout.
+	bool read_events (int timeout, Paths* changed);
+
+	int fd_;
+
+	// Directories are watched instead of the files, because the editors
+	// often replace the file with a new one.
+	std::unordered_map <int, std::filesystem::path> directories_;
+
+	// Absolute path -> snapshot file index
+	std::unordered_map <std::string, size_t> watched_;
+#endif
+
+	Paths files_;
+	std::vector <Time> times_;
+};
+
+#endif
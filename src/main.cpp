@@ -27,5 +27,5 @@
 
 int main (int argc, char* argv [])
 {
-	return Compiler ().main (argc, argv);
+	return Compiler ().run (argc, argv);
 }
@@ -0,0 +1,20 @@
+# Compile keywords.idl and check the constant names in the client header.
+# Parameters: NIDL2CPP, IDL, OUT.
+
+file(REMOVE_RECURSE ${OUT})
+file(MAKE_DIRECTORY ${OUT})
+execute_process(COMMAND ${NIDL2CPP} -no_ami -client -no_client_cpp -out ${OUT} ${IDL}
+	RESULT_VARIABLE result)
+if(NOT result EQUAL 0)
+	message(FATAL_ERROR "nidl2cpp failed: ${result}")
+endif()
+
+file(READ ${OUT}/keywords.h header)
+foreach(id class throw thread_local using what)
+	if(NOT header MATCHES " _cxx_${id} = ")
+		message(FATAL_ERROR "Identifier ${id} is not protected")
+	endif()
+endforeach()
+if(NOT header MATCHES " value = " OR header MATCHES "_cxx_value")
+	message(FATAL_ERROR "Identifier value must not be protected")
+endif()
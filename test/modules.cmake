@@ -0,0 +1,15 @@
+# Compile export.idl with -modules and check the module name in the interface unit.
+# Parameters: NIDL2CPP, IDL, OUT.
+
+file(REMOVE_RECURSE ${OUT})
+file(MAKE_DIRECTORY ${OUT})
+execute_process(COMMAND ${NIDL2CPP} -no_ami -client -no_client_cpp -modules -out ${OUT} ${IDL}
+	RESULT_VARIABLE result)
+if(NOT result EQUAL 0)
+	message(FATAL_ERROR "nidl2cpp failed: ${result}")
+endif()
+
+file(READ ${OUT}/export.cppm unit)
+if(NOT unit MATCHES "export module _cxx_export;")
+	message(FATAL_ERROR "Module name export is not protected")
+endif()